@@ -5,11 +5,8 @@
 #include "LiftSimulatorItem.h"
 #include <cnoid/Archive>
 #include <cnoid/Body>
-#include <cnoid/BoundingBox>
+#include <cnoid/DeviceList>
 #include <cnoid/ItemManager>
-#include <cnoid/MathUtil>
-#include <cnoid/MessageView>
-#include <cnoid/SceneShape>
 #include <cnoid/SimulatorItem>
 #include <cnoid/WorldItem>
 
@@ -51,7 +48,10 @@ bool LiftSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
     const vector<SimulationBody*>& simBodies = simulatorItem->simulationBodies();
     for(auto& simBody : simBodies) {
         Body* body = simBody->body();
-        wings << body->devices();
+        DeviceList<WingDevice> bodyWings(body->devices());
+        for(auto& wing : bodyWings) {
+            wings.addWing(wing);
+        }
     }
 
     WorldItem* worldItem = simulatorItem->findOwnerItem<WorldItem>();
@@ -61,6 +61,7 @@ bool LiftSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
     for(auto& collider : colliders) {
         collider->setUnsteadyFlow(Vector3(0.0, 0.0, 0.0));
     }
+    colliderIndex.setColliders(colliders);
 
     if(simBodies.size()) {
         simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
@@ -72,47 +73,8 @@ bool LiftSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
 
 void LiftSimulatorItem::onPreDynamics()
 {
-    for(auto& wing : wings) {
-        Link* link = wing->link();
-        Vector3 cb = link->T() * link->centerOfMass();
-
-        MultiColliderItem* item = nullptr;
-        for(auto& collider : colliders) {
-            if(collision(collider, link->T().translation())) {
-                item = collider;
-            }
-        }
-
-        if(item) {
-            double density = item->density();
-            const BoundingBox& bb = link->visualShape()->boundingBox();
-            // double s = wing->wingspan() * wing->chordLength();
-            double s = bb.size().x() * bb.size().y();
-            double cl = wing->cl();
-            Vector3 v = link->v();
-            double v_norm = v.dot(v);
-            double v2 = v_norm * v_norm;
-            Vector3 v_local = link->R().inverse() * v;
-            double aoa = -atan2(v_local.z(), v_local.x()) * TO_DEGREE;
-            cl = aoa * 0.1;
-
-            Vector3 unit_x = Vector3::UnitX();
-            Vector3 unit_z = Vector3::UnitZ();
-
-            Vector3 a = link->R() * unit_x;
-            Vector3 b = link->R() * unit_z;
-
-            if(wing->on()) {
-                if(a.dot(v) > 0.0) {
-                    Vector3 n = v.cross(b).cross(v).normalized();
-                    Vector3 lift = 0.5 * cl * density * v2 * s * n;
-
-                    link->f_ext() += lift;
-                    link->tau_ext() += cb.cross(lift);
-                }
-            }
-        }
-    }
+    colliderIndex.update();
+    wings.applyForces(colliderIndex);
 }
 
 
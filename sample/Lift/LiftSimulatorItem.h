@@ -5,12 +5,12 @@
 #ifndef CNOID_SAMPLE_LIFT_SIMULATOR_ITEM_H
 #define CNOID_SAMPLE_LIFT_SIMULATOR_ITEM_H
 
-#include <cnoid/DeviceList>
 #include <cnoid/ItemList>
 #include <cnoid/SimulatorItem>
 #include <cnoid/SubSimulatorItem>
 #include <cnoid/MultiColliderItem>
-#include <cnoid/WingDevice>
+#include <cnoid/ColliderIndex>
+#include <cnoid/WingAerodynamics>
 
 namespace cnoid {
 
@@ -31,8 +31,9 @@ protected:
 
 private:
     SimulatorItem* simulatorItem;
-    DeviceList<WingDevice> wings;
+    WingAerodynamics wings;
     ItemList<MultiColliderItem> colliders;
+    ColliderIndex colliderIndex;
 
     void onPreDynamics();
 };
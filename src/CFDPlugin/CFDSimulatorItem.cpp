@@ -5,20 +5,36 @@
 #include "CFDSimulatorItem.h"
 #include <cnoid/Archive>
 #include <cnoid/Body>
+#include <cnoid/BodyItem>
 #include <cnoid/DeviceList>
 #include <cnoid/EigenArchive>
 #include <cnoid/ItemManager>
 #include <cnoid/MathUtil>
 #include <cnoid/MeshExtractor>
+#include <cnoid/MessageView>
+#include <cnoid/Format>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/SceneDrawables>
+#include <cnoid/Selection>
 #include <cnoid/SimulatorItem>
 #include <cnoid/WorldItem>
 #include <cnoid/MultiColliderItem>
+#include <cnoid/ColliderIndex>
+#include <unordered_map>
 #include <vector>
+#include "DragExposureTable.h"
+#include "DragPanelCache.h"
+#include "DragPanelSet.h"
 #include "FlightEventReader.h"
+#include "FlightEventTimeline.h"
+#include "FlowFieldStream.h"
+#include "FluidForceEvaluator.h"
+#include "ImmersionHull.h"
 #include "Rotor.h"
+#include "RotorWakeField.h"
 #include "Thruster.h"
+#include "WingAerodynamics.h"
+#include "WorkerPool.h"
 #include "gettext.h"
 
 using namespace std;
@@ -30,23 +46,20 @@ const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
 
 class CFDBody;
 
-class CFDLink : public Referenced
+class CFDLink : public Referenced, public FluidLink
 {
 public:
     CFDLink(CFDSimulatorItemImpl* simImpl, CFDBody* cfdBody, Link* link);
     ~CFDLink();
 
-    Link* link;
-    double density;
-    Vector3 centerOfBuoyancy;
-    double cdw;
-    double cda;
-    double cv;
-    double cw;
-    vector<Vector3> sn;
-    vector<Vector3> g;
+    double panelTolerance;
+    int maxNumPanels;
+    int exposureResolution;
+    bool usePartialBuoyancy;
+    vector<Vector3> triangleVertices;
 
     void calcGeometry(CFDBody* cfdBody);
+    DragPanelCache::PanelsPtr extractPanels(CFDBody* cfdBody);
     void calcMesh(MeshExtractor* extractor, CFDBody* cfdBody);
 };
 
@@ -62,6 +75,10 @@ public:
     size_t numCFDLinks() const { return cfdLinks.size(); }
 
     vector<CFDLinkPtr> cfdLinks;
+    vector<const ColliderSnapshot*> hitColliders;
+    vector<double> hitWeights;
+    std::time_t fileTime;
+    int bodyIndex;
 
     void createBody(CFDSimulatorItemImpl* simImpl);
     void updateDevices();
@@ -69,9 +86,37 @@ public:
 
 typedef ref_ptr<CFDBody> CFDBodyPtr;
 
-struct BatteryInfo {
+struct Battery {
+    double capacity;            // [Ah]
+    double charge;              // [Ah]
+    double voltage;             // open circuit voltage when fully charged [V]
+    double cutoffVoltage;       // open circuit voltage when empty [V]
+    double internalResistance;  // [ohm]
+    double efficiency;          // ratio of the induced power to the electric power
+    double terminalVoltage;
+    double current;
+    double lastCurrent;
+    bool isEmpty;
+};
+
+struct WakeSource {
+    int owner;
+    Vector3 position;
+    Vector3 direction;
+    double radius;
+    double inducedVelocity;
+};
+
+struct RotorState {
     Rotor* rotor;
+    Link* link;
+    int bodyIndex;
+    int batteryIndex;
+    // flight event applied to the body without a battery, or nullptr
+    const FlightEvent* event;
+    // remaining flight time given by the event, or a negative value
     double duration;
+    bool isBatteryEmpty;
 };
 
 }
@@ -86,19 +131,46 @@ public:
     CFDSimulatorItemImpl(CFDSimulatorItem* self);
     CFDSimulatorItemImpl(CFDSimulatorItem* self, const CFDSimulatorItemImpl& org);
 
+    enum PanelLayoutId { AOS, SOA };
+
     vector<CFDBody*> cfdBodies;
     DeviceList<Thruster> thrusters;
     DeviceList<Rotor> rotors;
     Vector3 gravity;
     ItemList<MultiColliderItem> colliders;
-    vector<BatteryInfo> batteryInfo;
+    unordered_map<MultiColliderItem*, FlowFieldStreamPtr> flowFields;
+    double flowTime;
+    ColliderIndex colliderIndex;
+    vector<const ColliderSnapshot*> hitColliders;
+    vector<Battery> batteries;
+    vector<RotorState> rotorStates;
+    RotorWakeField wakeField;
+    vector<WakeSource> wakeSources;
+    WingAerodynamics wingAerodynamics;
+    FluidForceEvaluator forceEvaluator;
     string flight_event_file_path;
-    vector<FlightEvent> events;
+    FlightEventTimelinePtr timeline;
+    // time when the flight events applied to the bodies are looked up next, or a negative value
+    double nextFlightEventTime;
+    Selection panelLayout;
+    WorkerPool workerPool;
+    bool isDiskCacheEnabled;
+    bool isFlowLoopEnabled;
+    bool isDownwashEnabled;
+    bool isWingLiftEnabled;
+    bool isBoundaryBlendingEnabled;
+    bool isMultiThreaded;
+    int numThreads;
 
     double world_time_step;
 
     bool initializeSimulation(SimulatorItem* simulatorItem);
+    bool readBattery(const Mapping* info, Battery& battery);
+    void updateBatteries();
+    void applyFlightEvents(double time);
     void addBody(CFDBody* cfdBody);
+    void calcBodyForces(CFDBody* cfdBody);
+    double calcRotorWake(RotorState& state, const Vector3& p, const Vector3& thrustAxis, double density, double thrust);
     void onPreDynamics();
 };
 
@@ -108,14 +180,14 @@ public:
 CFDLink::CFDLink(CFDSimulatorItemImpl* simImpl, CFDBody* cfdBody, Link* link)
 {
     this->link = link;
-    density = 0.0;
-    centerOfBuoyancy << 0.0, 0.0, 0.0;
-    cdw = 0.0;
-    cda = 0.0;
-    cv = 0.0;
-    cw = 0.0;
+    panelTolerance = 0.0;
+    maxNumPanels = 0;
+    exposureResolution = 0;
+    usePartialBuoyancy = false;
+    usePackedPanels = simImpl->panelLayout.is(CFDSimulatorItemImpl::SOA);
     sn.clear();
     g.clear();
+    panels.clear();
 }
 
 
@@ -127,18 +199,76 @@ CFDLink::~CFDLink()
 
 void CFDLink::calcGeometry(CFDBody* cfdBody)
 {
-    if(link->collisionShape()) {
-        MeshExtractor* extractor = new MeshExtractor;
+    SgNode* shape = link->collisionShape();
+    if(!shape) {
+        return;
+    }
 
-        if(extractor->extract(link->collisionShape(),
-            [this, extractor, cfdBody](){ calcMesh(extractor, cfdBody); })) {
+    const double parameters[] = {
+        panelTolerance, (double)maxNumPanels, (double)exposureResolution, (double)usePartialBuoyancy };
+    uint64_t parameterKey = DragPanelCache::hash(parameters, sizeof(parameters));
+    DragPanelCache::PanelsPtr cachedPanels =
+        DragPanelCache::instance()->getPanels(
+            shape, cfdBody->fileTime, parameterKey, [&](){ return extractPanels(cfdBody); });
+    if(!cachedPanels) {
+        return;
+    }
+
+    exposure.setAreas(cachedPanels->exposureResolution, cachedPanels->exposure);
+    if(usePartialBuoyancy) {
+        hull.build(cachedPanels->hullVertices);
+    }
 
+    if(usePackedPanels) {
+        panels.clear();
+        panels.reserve(cachedPanels->sn.size());
+        for(size_t i = 0; i < cachedPanels->sn.size(); ++i) {
+            panels.addPanel(cachedPanels->sn[i], cachedPanels->g[i]);
         }
-        delete extractor;
+    } else {
+        sn = cachedPanels->sn;
+        g = cachedPanels->g;
     }
 }
 
 
+DragPanelCache::PanelsPtr CFDLink::extractPanels(CFDBody* cfdBody)
+{
+    MeshExtractor* extractor = new MeshExtractor;
+
+    if(extractor->extract(link->collisionShape(),
+        [this, extractor, cfdBody](){ calcMesh(extractor, cfdBody); })) {
+
+    }
+    delete extractor;
+
+    if(panelTolerance > 0.0 || maxNumPanels > 0) {
+        int numTriangles = sn.size();
+        int numPanels = clusterDragPanels(sn, g, radian(panelTolerance), maxNumPanels);
+        if(numPanels < numTriangles) {
+            MessageView::instance()->putln(
+                formatR(_("Drag panels of {0} were reduced from {1} to {2}."),
+                        link->name(), numTriangles, numPanels));
+        }
+    }
+
+    auto extracted = std::make_shared<DragPanelCache::Panels>();
+    if(exposureResolution > 0) {
+        DragExposureTable table;
+        table.build(triangleVertices, exposureResolution);
+        extracted->exposureResolution = table.resolution();
+        extracted->exposure = table.areas();
+    }
+    if(usePartialBuoyancy) {
+        extracted->hullVertices = triangleVertices;
+    }
+    vector<Vector3>().swap(triangleVertices);
+    extracted->sn.swap(sn);
+    extracted->g.swap(g);
+    return extracted;
+}
+
+
 void CFDLink::calcMesh(MeshExtractor* extractor, CFDBody* cfdBody)
 {
     SgMesh* mesh = extractor->currentMesh();
@@ -151,6 +281,8 @@ void CFDLink::calcMesh(MeshExtractor* extractor, CFDBody* cfdBody)
     }
 
     const int numTriangles = mesh->numTriangles();
+    sn.reserve(sn.size() + numTriangles);
+    g.reserve(g.size() + numTriangles);
     for(int i = 0; i < numTriangles; ++i) {
         SgMesh::TriangleRef src = mesh->triangle(i);
         Vector3 a = vertices_[src[0]].cast<Isometry3::Scalar>();
@@ -162,6 +294,11 @@ void CFDLink::calcMesh(MeshExtractor* extractor, CFDBody* cfdBody)
         Vector3 n = v0.cross(v1).normalized();
         sn.push_back(n * s);
         g.push_back((a + b + c) / 3.0);
+        if(exposureResolution > 0 || usePartialBuoyancy) {
+            triangleVertices.push_back(a);
+            triangleVertices.push_back(b);
+            triangleVertices.push_back(c);
+        }
     }
 }
 
@@ -170,6 +307,8 @@ CFDBody::CFDBody(Body* body)
     : SimulationBody(body)
 {
     cfdLinks.clear();
+    fileTime = 0;
+    bodyIndex = -1;
 }
 
 
@@ -196,6 +335,10 @@ void CFDBody::createBody(CFDSimulatorItemImpl* simImpl)
         node.read("cda", cfdLink->cda);
         node.read("cv", cfdLink->cv);
         node.read("cw", cfdLink->cw);
+        node.read("panel_tolerance", cfdLink->panelTolerance);
+        node.read("panel_count", cfdLink->maxNumPanels);
+        node.read("exposure_resolution", cfdLink->exposureResolution);
+        node.read("partial_buoyancy", cfdLink->usePartialBuoyancy);
 
         cfdLink->calcGeometry(this);
         cfdLinks.push_back(cfdLink);
@@ -236,14 +379,33 @@ CFDSimulatorItem::CFDSimulatorItem()
 CFDSimulatorItemImpl::CFDSimulatorItemImpl(CFDSimulatorItem* self)
     : self(self),
       world_time_step(0.0),
-      flight_event_file_path("")
+      flight_event_file_path(""),
+      isDiskCacheEnabled(false),
+      isFlowLoopEnabled(false),
+      isDownwashEnabled(false),
+      isWingLiftEnabled(false),
+      isBoundaryBlendingEnabled(false),
+      isMultiThreaded(false),
+      numThreads(0)
 {
     cfdBodies.clear();
     thrusters.clear();
     rotors.clear();
     colliders.clear();
-    batteryInfo.clear();
-    events.clear();
+    flowFields.clear();
+    flowTime = 0.0;
+    batteries.clear();
+    rotorStates.clear();
+    wakeField.clear();
+    wakeField.clearObstacles();
+    wakeSources.clear();
+    wingAerodynamics.clear();
+    timeline.reset();
+    nextFlightEventTime = -1.0;
+
+    panelLayout.setSymbol(AOS, N_("AoS"));
+    panelLayout.setSymbol(SOA, N_("SoA"));
+    panelLayout.select(SOA);
 
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
 }
@@ -262,6 +424,14 @@ CFDSimulatorItemImpl::CFDSimulatorItemImpl(CFDSimulatorItem* self, const CFDSimu
 {
     gravity = org.gravity;
     flight_event_file_path = org.flight_event_file_path;
+    panelLayout = org.panelLayout;
+    isDiskCacheEnabled = org.isDiskCacheEnabled;
+    isFlowLoopEnabled = org.isFlowLoopEnabled;
+    isDownwashEnabled = org.isDownwashEnabled;
+    isWingLiftEnabled = org.isWingLiftEnabled;
+    isBoundaryBlendingEnabled = org.isBoundaryBlendingEnabled;
+    isMultiThreaded = org.isMultiThreaded;
+    numThreads = org.numThreads;
 }
 
 
@@ -283,15 +453,33 @@ bool CFDSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorItem)
     thrusters.clear();
     rotors.clear();
     colliders.clear();
-    batteryInfo.clear();
-    events.clear();
+    flowFields.clear();
+    flowTime = 0.0;
+    batteries.clear();
+    rotorStates.clear();
+    wakeField.clear();
+    wakeField.clearObstacles();
+    wakeSources.clear();
+    wingAerodynamics.clear();
+    timeline.reset();
+    nextFlightEventTime = -1.0;
     gravity = simulatorItem->getGravity();
     world_time_step = simulatorItem->worldTimeStep();
+    forceEvaluator.setGravity(gravity);
+    forceEvaluator.setColliderIndex(&colliderIndex);
+    forceEvaluator.setFlowFields(&flowFields);
+    forceEvaluator.setWakeField(&wakeField);
+    forceEvaluator.setBoundaryBlendingEnabled(isBoundaryBlendingEnabled);
+    if(isMultiThreaded) {
+        workerPool.setNumThreads(numThreads);
+    }
+    DragPanelCache::instance()->setDiskCacheEnabled(isDiskCacheEnabled);
 
     if(!flight_event_file_path.empty()) {
         FlightEventReader reader;
         if(reader.load(flight_event_file_path)) {
-            events = reader.events();
+            timeline = std::make_shared<const FlightEventTimeline>(reader.events());
+            nextFlightEventTime = 0.0;
         }
     }
 
@@ -300,26 +488,52 @@ bool CFDSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorItem)
         Body* body = simBody->body();
         // addBody(static_cast<CFDBody*>(simBodies[i]));
         CFDBody* cfdBody = new CFDBody(body);
+        if(BodyItem* bodyItem = simBody->bodyItem()) {
+            cfdBody->fileTime = bodyItem->fileModificationTime();
+        }
         cfdBody->createBody(this);
+        cfdBody->bodyIndex = cfdBodies.size();
         cfdBodies.push_back(cfdBody);
         thrusters << body->devices();
-        rotors << body->devices();
-    }
 
-    for(auto& rotor : rotors) {
-        Link* link = rotor->link();
-        Body* body = link->body();
-        double mass = body->mass();
-        double duration = 0.0;
-
-        for(auto& event : events) {
-            if(mass < event.mass()) {
-                duration = event.duration();
+        if(isWingLiftEnabled) {
+            DeviceList<WingDevice> wings(body->devices());
+            for(auto& wing : wings) {
+                wingAerodynamics.addWing(wing);
+                if(!wing->cdTable().empty()) {
+                    for(auto& cfdLink : cfdBody->cfdLinks) {
+                        if(cfdLink->link == wing->link()) {
+                            cfdLink->isPanelDragEnabled = false;
+                        }
+                    }
+                }
             }
         }
-        if(duration > 0.0) {
-            batteryInfo.push_back({ rotor, duration });
+
+        if(isDownwashEnabled && body->isStaticModel()) {
+            // The links are approximated by their bounding boxes, which is coarse for
+            // a terrain made of a single link. Such a terrain should be split into links.
+            for(auto& link : body->links()) {
+                if(SgNode* shape = link->collisionShape()) {
+                    BoundingBox bbox = shape->boundingBox();
+                    bbox.transform(Affine3(link->T()));
+                    wakeField.addObstacle(bbox);
+                }
+            }
+        }
+
+        int batteryIndex = -1;
+        Battery battery;
+        if(readBattery(body->info()->findMapping("battery"), battery)) {
+            batteryIndex = batteries.size();
+            batteries.push_back(battery);
+        }
+
+        DeviceList<Rotor> bodyRotors(body->devices());
+        for(auto& rotor : bodyRotors) {
+            rotorStates.push_back({ rotor, rotor->link(), cfdBody->bodyIndex, batteryIndex, nullptr, -1.0, false });
         }
+        rotors << bodyRotors;
     }
 
     WorldItem* worldItem = simulatorItem->findOwnerItem<WorldItem>();
@@ -333,7 +547,17 @@ bool CFDSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorItem)
     }
     for(auto& collider : colliders) {
         collider->setUnsteadyFlow(Vector3(0.0, 0.0, 0.0));
+        if(!collider->flowFieldFile().empty()) {
+            string message;
+            FlowFieldGridPtr grid = FlowFieldGrid::open(collider->flowFieldFile(), message);
+            if(grid) {
+                flowFields[collider] = std::make_shared<FlowFieldStream>(grid, isFlowLoopEnabled);
+            } else {
+                MessageView::instance()->putln(message);
+            }
+        }
     }
+    colliderIndex.setColliders(colliders);
 
     if(cfdBodies.size()) {
         simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
@@ -351,93 +575,80 @@ void CFDSimulatorItemImpl::addBody(CFDBody* cfdBody)
 }
 
 
-void CFDSimulatorItemImpl::onPreDynamics()
+void CFDSimulatorItemImpl::calcBodyForces(CFDBody* cfdBody)
 {
-    for(auto& cfdBody : cfdBodies) {
-        for(int j = 0; j < cfdBody->numCFDLinks(); ++j) {
-            CFDLink* cfdLink = cfdBody->cfdLink(j);
-            Link* link = cfdLink->link;
-            const Isometry3& T = link->T();
-
-            double density = 0.0;
-            double viscosity = 0.0;
-            Vector3 sf = Vector3::Zero();
-            for(auto& collider : colliders) {
-                auto rot = collider->position().linear();
-                if(collision(collider, T.translation())) {
-                    density = collider->density();
-                    viscosity = collider->viscosity();
-                    sf += rot * collider->steadyFlow();
-                    sf += rot * collider->unsteadyFlow();
-                }
-            }
+    for(auto& cfdLink : cfdBody->cfdLinks) {
+        forceEvaluator.calcLinkForces(*cfdLink, cfdBody->bodyIndex, cfdBody->hitColliders, cfdBody->hitWeights);
+    }
+}
 
-            // buoyancy
-            if(cfdLink->density > 0.0) {
-                double volume = link->mass() / cfdLink->density;
-                Vector3 b = density * gravity * volume * -1.0;
-                link->f_ext() += b;
-                Vector3 cb = T * cfdLink->centerOfBuoyancy;
-                link->tau_ext() += cb.cross(b);
-            }
 
-            //flow
-            link->f_ext() += sf;
-            Vector3 c = T * link->centerOfMass();
-            link->tau_ext() += c.cross(sf);
+void CFDSimulatorItemImpl::applyFlightEvents(double time)
+{
+    // the flight time starts over when the event applied to a body changes,
+    // and the rotors run without a limit again while no event applies
+    for(auto& state : rotorStates) {
+        if(state.batteryIndex >= 0) {
+            continue;
+        }
+        const FlightEvent* event = timeline->findEvent(cfdBodies[state.bodyIndex]->body()->mass(), time);
+        if(event != state.event) {
+            state.event = event;
+            state.duration = (event && event->duration() > 0.0) ? event->duration() : -1.0;
+            state.isBatteryEmpty = false;
+        }
+    }
+    nextFlightEventTime = timeline->nextChangeTime(time);
+}
 
-            //drag
-            double cd = 0.0;
-            if(density > 10.0) {
-                cd = cfdLink->cdw;
-            } else {
-                cd = cfdLink->cda;
-            }
 
-            Vector3 a = link->R() * link->centerOfMass();
-            Vector3 w = link->w();
-            Vector3 v = link->v() + w.cross(a);
-
-            double v_norm = v.dot(v);
-            double v2 = v_norm * v_norm;
-            // Vector3 v_local = link->R().inverse() * v;
-            Vector3 n = v.normalized();
-            double p = 0.5 * density * v2;
-
-            for(int k = 0; k < cfdLink->sn.size(); ++k) {
-                Vector3 sn = link->R() * cfdLink->sn[k];
-                double s = n.dot(sn);
-                if(s > 0.0) {
-                    Vector3 f = p * cd * s * n * -1.0;
-                    link->f_ext() += f;
-                    link->tau_ext() += c.cross(f);
-                    Vector3 g = T * cfdLink->g[k];
-                    // link->tau_ext() += g.cross(f);
-                }
-            }
+void CFDSimulatorItemImpl::onPreDynamics()
+{
+    // flowTime is the elapsed time of the simulation
+    if(nextFlightEventTime >= 0.0 && flowTime >= nextFlightEventTime) {
+        applyFlightEvents(flowTime);
+    }
 
-            //viscous drag
-            Vector3 fv = cfdLink->cv * viscosity * v * -1.0;
-            Vector3 tv = cfdLink->cw * viscosity * w * -1.0;
-            link->f_ext() += fv;
-            link->tau_ext() += c.cross(fv) + tv;
+    colliderIndex.update();
+    for(auto& flowField : flowFields) {
+        flowField.second->update(flowTime);
+    }
+    flowTime += world_time_step;
+
+    // The forces of each body only depend on its own links and the colliders,
+    // so the bodies are evaluated independently into the per-link accumulators
+    // and committed in a fixed order to keep the result deterministic.
+    if(isMultiThreaded) {
+        workerPool.parallelFor(cfdBodies.size(),
+                               [&](int index){ calcBodyForces(cfdBodies[index]); });
+    } else {
+        for(auto& cfdBody : cfdBodies) {
+            calcBodyForces(cfdBody);
         }
+    }
 
+    for(auto& cfdBody : cfdBodies) {
+        for(auto& cfdLink : cfdBody->cfdLinks) {
+            Link* link = cfdLink->link;
+            link->f_ext() += cfdLink->f;
+            link->tau_ext() += cfdLink->tau;
+        }
         cfdBody->updateDevices();
     }
 
+    // wing
+    if(wingAerodynamics.numWings() > 0) {
+        wingAerodynamics.applyForces(colliderIndex, isBoundaryBlendingEnabled);
+    }
+
     // thruster
     for(auto& thruster : thrusters) {
         Link* link = thruster->link();
-        MultiColliderItem* item = nullptr;
-        for(auto& collider : colliders) {
-            if(collision(collider, link->T().translation())) {
-                item = collider;
-            }
-        }
+        colliderIndex.queryColliders(link->T().translation(), hitColliders);
+        const ColliderSnapshot* item = hitColliders.empty() ? nullptr : hitColliders.back();
 
         if(item) {
-            double density = item->density();
+            double density = item->density;
             if(density > 10.0) {
                 Matrix3 R = link->R() * thruster->R_local();
                 Vector3 direction = thruster->direction();
@@ -453,59 +664,137 @@ void CFDSimulatorItemImpl::onPreDynamics()
     }
 
     // rotor
-    for(auto& rotor : rotors) {
-        Link* link = rotor->link();
-        MultiColliderItem* item = nullptr;
-        for(auto& collider : colliders) {
-            if(collision(collider, link->T().translation())) {
-                item = collider;
-            }
-        }
-
-        bool is_battery_empty = false;
-        if(events.size()) {
-            for(auto& info : batteryInfo) {
-                if(info.rotor == rotor) {
-                    info.duration -= world_time_step;
-                    if(info.duration < 0.0) {
-                        is_battery_empty = true;
-                    }
+    for(auto& state : rotorStates) {
+        Rotor* rotor = state.rotor;
+        Link* link = state.link;
+        Battery* battery = state.batteryIndex >= 0 ? &batteries[state.batteryIndex] : nullptr;
+        colliderIndex.queryColliders(link->T().translation(), hitColliders);
+        const ColliderSnapshot* item = hitColliders.empty() ? nullptr : hitColliders.back();
+
+        if(!state.isBatteryEmpty) {
+            if(battery) {
+                state.isBatteryEmpty = battery->isEmpty;
+            } else if(state.duration >= 0.0) {
+                state.duration -= world_time_step;
+                if(state.duration < 0.0) {
+                    state.isBatteryEmpty = true;
                 }
             }
         }
 
         if(item) {
-            double density = item->density();
+            double density = item->density;
             if(density < 10.0) {
-                double n = rotor->kv() * rotor->voltage();
-                double d3 = rotor->diameter() / 10.0;
-                double p1 = rotor->pitch() / 10.0;
-                double k = rotor->k();
-                double g = fabs(gravity[2]);
-                if(n <= 0.0) {
-                    n = link->dq_target() * 30.0 / PI;
-                } else {
-                    double dir = 1.0;
-                    if(rotor->reverse()) {
-                        dir *= -1.0;
-                    }
-                    link->dq_target() = n * PI / 30.0 * dir;
+                double voltage = rotor->voltage();
+                if(battery) {
+                    // the motor cannot be driven above the sagged battery voltage
+                    voltage = std::min(voltage, battery->terminalVoltage);
                 }
-                double n2 = n / 1000.0;
-                double staticForce = k * d3 * d3 * d3 * p1 * n2 * n2 * g / 1000.0;
+                double staticForce = forceEvaluator.calcRotorThrust(rotor, voltage);
 
                 Matrix3 R = link->R() * rotor->R_local();
                 Vector3 direction = rotor->direction();
-                const Vector3 f = R * (direction * (rotor->force() + rotor->forceOffset() + staticForce));
                 const Vector3 p = link->T() * rotor->p_local();
+                if(isDownwashEnabled && staticForce > 0.0 && density > 0.0) {
+                    staticForce = calcRotorWake(state, p, (R * direction).normalized(), density, staticForce);
+                }
+                const Vector3 f = R * (direction * (rotor->force() + rotor->forceOffset() + staticForce));
                 Vector3 tau_ext = R * (direction * (rotor->torque() + rotor->torqueOffset()));
-                if(rotor->on() && !is_battery_empty) {
+                if(rotor->on() && !state.isBatteryEmpty) {
                     link->f_ext() += f;
                     link->tau_ext() += p.cross(f) + tau_ext;
+
+                    if(battery && staticForce > 0.0 && density > 0.0 && battery->terminalVoltage > 0.0) {
+                        // momentum theory gives the induced power of the thrust
+                        double radius = rotor->diameter() * 0.0254 / 2.0;
+                        double area = PI * radius * radius;
+                        double power = staticForce * sqrt(staticForce / (2.0 * density * area));
+                        battery->current += power / battery->efficiency / battery->terminalVoltage;
+                    }
                 }
             }
         }
     }
+
+    updateBatteries();
+
+    if(isDownwashEnabled) {
+        wakeField.clear();
+        for(auto& source : wakeSources) {
+            wakeField.addWake(source.owner, source.position, source.direction, source.radius, source.inducedVelocity);
+        }
+        wakeField.build();
+        wakeSources.clear();
+    }
+}
+
+
+double CFDSimulatorItemImpl::calcRotorWake
+(RotorState& state, const Vector3& p, const Vector3& thrustAxis, double density, double thrust)
+{
+    const double radius = state.rotor->diameter() * 0.0254 / 2.0;
+    const double area = PI * radius * radius;
+    if(area <= 0.0) {
+        return thrust;
+    }
+
+    thrust = forceEvaluator.calcRotorWake(state.rotor, state.bodyIndex, p, thrustAxis, density, thrust);
+
+    if(state.rotor->on() && !state.isBatteryEmpty && thrust > 0.0) {
+        wakeSources.push_back({ state.bodyIndex, p, -thrustAxis, radius, sqrt(thrust / (2.0 * density * area)) });
+    }
+    return thrust;
+}
+
+
+bool CFDSimulatorItemImpl::readBattery(const Mapping* info, Battery& battery)
+{
+    if(!info->isValid()) {
+        return false;
+    }
+
+    battery.capacity = 0.0;
+    battery.voltage = 0.0;
+    info->read("capacity", battery.capacity);
+    info->read("voltage", battery.voltage);
+    if(battery.capacity <= 0.0 || battery.voltage <= 0.0) {
+        return false;
+    }
+    battery.cutoffVoltage = info->get("cutoff_voltage", battery.voltage * 0.8);
+    battery.internalResistance = info->get("internal_resistance", 0.0);
+    battery.efficiency = info->get("efficiency", 0.5);
+    if(battery.efficiency <= 0.0) {
+        battery.efficiency = 1.0;
+    }
+    battery.charge = battery.capacity;
+    battery.terminalVoltage = battery.voltage;
+    battery.current = 0.0;
+    battery.lastCurrent = 0.0;
+    battery.isEmpty = false;
+    return true;
+}
+
+
+void CFDSimulatorItemImpl::updateBatteries()
+{
+    for(auto& battery : batteries) {
+        if(battery.isEmpty) {
+            continue;
+        }
+        battery.charge -= battery.current * world_time_step / 3600.0;
+        battery.lastCurrent = battery.current;
+        battery.current = 0.0;
+        if(battery.charge <= 0.0) {
+            battery.charge = 0.0;
+            battery.isEmpty = true;
+            battery.terminalVoltage = 0.0;
+            continue;
+        }
+        // the open circuit voltage drops linearly with the state of charge
+        double soc = battery.charge / battery.capacity;
+        double openCircuitVoltage = battery.cutoffVoltage + (battery.voltage - battery.cutoffVoltage) * soc;
+        battery.terminalVoltage = std::max(0.0, openCircuitVoltage - battery.lastCurrent * battery.internalResistance);
+    }
 }
 
 
@@ -523,6 +812,16 @@ void CFDSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
                     impl->flight_event_file_path = value;
                     return true;
                 });
+    putProperty(_("Drag panel layout"), impl->panelLayout,
+                [this](int which){ return impl->panelLayout.select(which); });
+    putProperty(_("Rotor downwash"), impl->isDownwashEnabled, changeProperty(impl->isDownwashEnabled));
+    putProperty(_("Wing lift"), impl->isWingLiftEnabled, changeProperty(impl->isWingLiftEnabled));
+    putProperty(_("Boundary blending"), impl->isBoundaryBlendingEnabled,
+                changeProperty(impl->isBoundaryBlendingEnabled));
+    putProperty(_("Loop flow fields"), impl->isFlowLoopEnabled, changeProperty(impl->isFlowLoopEnabled));
+    putProperty(_("Panel disk cache"), impl->isDiskCacheEnabled, changeProperty(impl->isDiskCacheEnabled));
+    putProperty(_("Multi-threaded"), impl->isMultiThreaded, changeProperty(impl->isMultiThreaded));
+    putProperty.min(0)(_("Number of threads"), impl->numThreads, changeProperty(impl->numThreads));
 }
 
 
@@ -532,6 +831,14 @@ bool CFDSimulatorItem::store(Archive& archive)
         return false;
     }
     archive.writeRelocatablePath("flight_event_file_path", impl->flight_event_file_path);
+    archive.write("drag_panel_layout", impl->panelLayout.selectedSymbol());
+    archive.write("rotor_downwash", impl->isDownwashEnabled);
+    archive.write("wing_lift", impl->isWingLiftEnabled);
+    archive.write("boundary_blending", impl->isBoundaryBlendingEnabled);
+    archive.write("loop_flow_fields", impl->isFlowLoopEnabled);
+    archive.write("panel_disk_cache", impl->isDiskCacheEnabled);
+    archive.write("multi_threaded", impl->isMultiThreaded);
+    archive.write("num_threads", impl->numThreads);
     return true;
 }
 
@@ -548,5 +855,15 @@ bool CFDSimulatorItem::restore(const Archive& archive)
             impl->flight_event_file_path = symbol;
         }
     }
+    if(archive.read("drag_panel_layout", symbol)) {
+        impl->panelLayout.select(symbol);
+    }
+    archive.read("rotor_downwash", impl->isDownwashEnabled);
+    archive.read("wing_lift", impl->isWingLiftEnabled);
+    archive.read("boundary_blending", impl->isBoundaryBlendingEnabled);
+    archive.read("loop_flow_fields", impl->isFlowLoopEnabled);
+    archive.read("panel_disk_cache", impl->isDiskCacheEnabled);
+    archive.read("multi_threaded", impl->isMultiThreaded);
+    archive.read("num_threads", impl->numThreads);
     return true;
 }
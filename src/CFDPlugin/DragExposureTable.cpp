@@ -0,0 +1,180 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "DragExposureTable.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// Direction of the center of the texel (i, j) on the face.
+// The faces are ordered as +X, -X, +Y, -Y, +Z, -Z like the cells of clusterDragPanels.
+Vector3 texelDirection(int face, int i, int j, int resolution)
+{
+    const int axis = face / 2;
+    const double sign = (face % 2) ? -1.0 : 1.0;
+    Vector3 d;
+    d[axis] = sign;
+    d[(axis + 1) % 3] = (i + 0.5) / resolution * 2.0 - 1.0;
+    d[(axis + 2) % 3] = (j + 0.5) / resolution * 2.0 - 1.0;
+    return d.normalized();
+}
+
+double edge(const Vector2& a, const Vector2& b, double x, double y)
+{
+    return (b.x() - a.x()) * (y - a.y()) - (b.y() - a.y()) * (x - a.x());
+}
+
+double silhouetteArea(const vector<Vector3>& triangleVertices, const Vector3& direction,
+                      int rasterResolution, vector<Vector2>& projected, vector<char>& mask)
+{
+    const Vector3 a = fabs(direction.x()) < 0.9 ? Vector3::UnitX() : Vector3::UnitY();
+    const Vector3 e1 = direction.cross(a).normalized();
+    const Vector3 e2 = direction.cross(e1);
+
+    const int numVertices = triangleVertices.size();
+    projected.resize(numVertices);
+    Vector2 lower(HUGE_VAL, HUGE_VAL);
+    Vector2 upper(-HUGE_VAL, -HUGE_VAL);
+    for(int i = 0; i < numVertices; ++i) {
+        Vector2& p = projected[i];
+        p << e1.dot(triangleVertices[i]), e2.dot(triangleVertices[i]);
+        lower = lower.cwiseMin(p);
+        upper = upper.cwiseMax(p);
+    }
+    const double extent = (upper - lower).maxCoeff();
+    if(!(extent > 0.0)) {
+        return 0.0;
+    }
+
+    const int n = rasterResolution;
+    const double pixelSize = extent / n;
+    for(auto& p : projected) {
+        p = (p - lower) / pixelSize;
+    }
+    mask.assign(n * n, 0);
+
+    for(int i = 0; i + 2 < numVertices; i += 3) {
+        const Vector2& p0 = projected[i];
+        const Vector2& p1 = projected[i + 1];
+        const Vector2& p2 = projected[i + 2];
+        const double area2 = edge(p0, p1, p2.x(), p2.y());
+        if(area2 == 0.0) {
+            continue;
+        }
+        const double s = area2 > 0.0 ? 1.0 : -1.0;
+        const int xmin = std::max(0, (int)floor(std::min({ p0.x(), p1.x(), p2.x() })));
+        const int xmax = std::min(n - 1, (int)ceil(std::max({ p0.x(), p1.x(), p2.x() })));
+        const int ymin = std::max(0, (int)floor(std::min({ p0.y(), p1.y(), p2.y() })));
+        const int ymax = std::min(n - 1, (int)ceil(std::max({ p0.y(), p1.y(), p2.y() })));
+        for(int y = ymin; y <= ymax; ++y) {
+            const double py = y + 0.5;
+            for(int x = xmin; x <= xmax; ++x) {
+                const double px = x + 0.5;
+                if(s * edge(p0, p1, px, py) >= 0.0
+                   && s * edge(p1, p2, px, py) >= 0.0
+                   && s * edge(p2, p0, px, py) >= 0.0) {
+                    mask[y * n + x] = 1;
+                }
+            }
+        }
+    }
+
+    const int numCovered = std::count(mask.begin(), mask.end(), 1);
+    return numCovered * pixelSize * pixelSize;
+}
+
+}
+
+
+DragExposureTable::DragExposureTable()
+{
+    clear();
+}
+
+
+void DragExposureTable::clear()
+{
+    resolution_ = 0;
+    areas_.clear();
+}
+
+
+bool DragExposureTable::setAreas(int resolution, const vector<double>& areas)
+{
+    if(resolution <= 0 || (int)areas.size() != 6 * resolution * resolution) {
+        clear();
+        return false;
+    }
+    resolution_ = resolution;
+    areas_ = areas;
+    return true;
+}
+
+
+void DragExposureTable::build(const vector<Vector3>& triangleVertices, int resolution, int rasterResolution)
+{
+    clear();
+    if(resolution <= 0 || rasterResolution <= 0 || triangleVertices.size() < 3) {
+        return;
+    }
+
+    resolution_ = resolution;
+    areas_.resize(6 * resolution * resolution);
+    vector<Vector2> projected;
+    vector<char> mask;
+
+    // The silhouettes seen from the opposite directions are the same,
+    // so only the positive faces are rasterized and mirrored to the negative ones.
+    for(int axis = 0; axis < 3; ++axis) {
+        const int face = axis * 2;
+        for(int i = 0; i < resolution; ++i) {
+            for(int j = 0; j < resolution; ++j) {
+                Vector3 d = texelDirection(face, i, j, resolution);
+                double area = silhouetteArea(triangleVertices, d, rasterResolution, projected, mask);
+                areas_[(face * resolution + i) * resolution + j] = area;
+                const int mi = resolution - 1 - i;
+                const int mj = resolution - 1 - j;
+                areas_[((face + 1) * resolution + mi) * resolution + mj] = area;
+            }
+        }
+    }
+}
+
+
+double DragExposureTable::projectedArea(const Vector3& direction) const
+{
+    if(areas_.empty()) {
+        return 0.0;
+    }
+
+    int axis;
+    direction.cwiseAbs().maxCoeff(&axis);
+    const double m = direction[axis];
+    if(m == 0.0) {
+        return 0.0;
+    }
+    const int face = axis * 2 + (m < 0.0 ? 1 : 0);
+    const int r = resolution_;
+    const double u = direction[(axis + 1) % 3] / fabs(m);
+    const double v = direction[(axis + 2) % 3] / fabs(m);
+
+    // continuous texel coordinates clamped to the texel centers of the face
+    const double x = std::max(0.0, std::min((u + 1.0) * 0.5 * r - 0.5, r - 1.0));
+    const double y = std::max(0.0, std::min((v + 1.0) * 0.5 * r - 0.5, r - 1.0));
+    const int i0 = std::min((int)x, r - 1);
+    const int j0 = std::min((int)y, r - 1);
+    const int i1 = std::min(i0 + 1, r - 1);
+    const int j1 = std::min(j0 + 1, r - 1);
+    const double tx = x - i0;
+    const double ty = y - j0;
+
+    const double* areas = &areas_[face * r * r];
+    const double a0 = areas[i0 * r + j0] * (1.0 - ty) + areas[i0 * r + j1] * ty;
+    const double a1 = areas[i1 * r + j0] * (1.0 - ty) + areas[i1 * r + j1] * ty;
+    return a0 * (1.0 - tx) + a1 * tx;
+}
@@ -0,0 +1,50 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_DRAG_EXPOSURE_TABLE_H
+#define CNOID_CFD_PLUGIN_DRAG_EXPOSURE_TABLE_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Projected area of a link seen from the flow, tabulated over a cube map of
+   flow directions. Each texel holds the area of the silhouette of the link
+   viewed along the direction of the texel center, so the panels hidden
+   behind other parts of the link do not contribute to the drag.
+*/
+class CNOID_EXPORT DragExposureTable
+{
+public:
+    DragExposureTable();
+
+    void clear();
+    bool empty() const { return areas_.empty(); }
+    int resolution() const { return resolution_; }
+    const std::vector<double>& areas() const { return areas_; }
+    bool setAreas(int resolution, const std::vector<double>& areas);
+
+    /**
+       @param triangleVertices vertices of the triangles in the link-local
+       frame, three for each triangle
+       @param resolution number of the texels along an edge of a cube face
+       @param rasterResolution number of the pixels along an edge of the
+       image the silhouette is rasterized into
+    */
+    void build(const std::vector<Vector3>& triangleVertices, int resolution, int rasterResolution = 64);
+
+    // Bilinearly interpolated area for a unit direction in the link-local frame
+    double projectedArea(const Vector3& direction) const;
+
+private:
+    int resolution_;
+    std::vector<double> areas_;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_DRAG_EXPOSURE_TABLE_H
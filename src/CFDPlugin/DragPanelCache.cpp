@@ -0,0 +1,297 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "DragPanelCache.h"
+#include <cnoid/MeshExtractor>
+#include <cnoid/Referenced>
+#include <cnoid/SceneDrawables>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char CacheFileMagic[8] = { 'C', 'F', 'D', 'P', 'A', 'N', 'E', 'L' };
+const uint32_t CacheFileVersion = 3;
+
+struct ShapeEntry
+{
+    weak_ref<SgNode> shape;
+    std::time_t fileTime;
+    uint64_t parameterKey;
+    DragPanelCache::PanelsPtr panels;
+};
+
+}
+
+namespace cnoid {
+
+class DragPanelCache::Impl
+{
+public:
+    Impl();
+
+    std::mutex mutex;
+    unordered_map<SgNode*, ShapeEntry> shapeEntries;
+    unordered_map<uint64_t, PanelsPtr> contentEntries;
+    bool isDiskCacheEnabled;
+
+    uint64_t calcContentKey(SgNode* shape, uint64_t parameterKey);
+    filesystem::path cacheFilePath(uint64_t contentKey);
+    PanelsPtr loadPanels(uint64_t contentKey);
+    bool savePanels(uint64_t contentKey, const Panels& panels);
+    void removeExpiredEntries();
+};
+
+}
+
+
+DragPanelCache* DragPanelCache::instance()
+{
+    static DragPanelCache cache;
+    return &cache;
+}
+
+
+DragPanelCache::DragPanelCache()
+{
+    impl = new Impl;
+}
+
+
+DragPanelCache::Impl::Impl()
+{
+    isDiskCacheEnabled = false;
+}
+
+
+DragPanelCache::~DragPanelCache()
+{
+    delete impl;
+}
+
+
+void DragPanelCache::setDiskCacheEnabled(bool on)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->isDiskCacheEnabled = on;
+}
+
+
+bool DragPanelCache::isDiskCacheEnabled() const
+{
+    return impl->isDiskCacheEnabled;
+}
+
+
+void DragPanelCache::clear()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->shapeEntries.clear();
+    impl->contentEntries.clear();
+}
+
+
+uint64_t DragPanelCache::hash(const void* data, size_t size, uint64_t seed)
+{
+    // FNV-1a
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+DragPanelCache::PanelsPtr DragPanelCache::getPanels
+(SgNode* shape, std::time_t fileTime, uint64_t parameterKey, const std::function<PanelsPtr()>& calcPanels)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+
+    auto p = impl->shapeEntries.find(shape);
+    if(p != impl->shapeEntries.end()) {
+        const ShapeEntry& entry = p->second;
+        if(entry.shape.lock().get() == shape && entry.fileTime == fileTime && entry.parameterKey == parameterKey) {
+            return entry.panels;
+        }
+    }
+
+    uint64_t contentKey = impl->calcContentKey(shape, parameterKey);
+    PanelsPtr panels;
+    auto q = impl->contentEntries.find(contentKey);
+    if(q != impl->contentEntries.end()) {
+        panels = q->second;
+    }
+    if(!panels && impl->isDiskCacheEnabled) {
+        panels = impl->loadPanels(contentKey);
+    }
+    if(!panels) {
+        panels = calcPanels();
+        if(!panels) {
+            return nullptr;
+        }
+        if(impl->isDiskCacheEnabled) {
+            impl->savePanels(contentKey, *panels);
+        }
+    }
+
+    impl->removeExpiredEntries();
+    impl->contentEntries[contentKey] = panels;
+    ShapeEntry& entry = impl->shapeEntries[shape];
+    entry.shape = weak_ref<SgNode>(shape);
+    entry.fileTime = fileTime;
+    entry.parameterKey = parameterKey;
+    entry.panels = panels;
+
+    return panels;
+}
+
+
+uint64_t DragPanelCache::Impl::calcContentKey(SgNode* shape, uint64_t parameterKey)
+{
+    uint64_t key = hash(&parameterKey, sizeof(parameterKey));
+
+    MeshExtractor extractor;
+    extractor.extract(shape, [&](){
+        SgMesh* mesh = extractor.currentMesh();
+        const Affine3& T = extractor.currentTransform();
+        // the parts are copied out so that the key does not depend on the storage of Affine3
+        const Matrix3 R = T.linear();
+        const Vector3 p = T.translation();
+        key = hash(R.data(), sizeof(double) * 9, key);
+        key = hash(p.data(), sizeof(double) * 3, key);
+        if(mesh->hasVertices()) {
+            const SgVertexArray& vertices = *mesh->vertices();
+            key = hash(vertices.data(), sizeof(Vector3f) * vertices.size(), key);
+        }
+        const SgIndexArray& indices = mesh->triangleVertices();
+        key = hash(indices.data(), sizeof(int) * indices.size(), key);
+    });
+
+    return key;
+}
+
+
+filesystem::path DragPanelCache::Impl::cacheFilePath(uint64_t contentKey)
+{
+    const char* home = getenv("HOME");
+    if(!home) {
+        return filesystem::path();
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.panels", (unsigned long long)contentKey);
+    return filesystem::path(fromUTF8(home)) / ".cache" / "choreonoid" / "cfd" / name;
+}
+
+
+DragPanelCache::PanelsPtr DragPanelCache::Impl::loadPanels(uint64_t contentKey)
+{
+    filesystem::path path = cacheFilePath(contentKey);
+    if(path.empty() || !filesystem::exists(path)) {
+        return nullptr;
+    }
+
+    std::ifstream ifs(path.string(), ios::binary);
+    char magic[8];
+    uint32_t version = 0;
+    uint64_t key = 0;
+    uint32_t n = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    ifs.read(reinterpret_cast<char*>(&key), sizeof(key));
+    ifs.read(reinterpret_cast<char*>(&n), sizeof(n));
+    if(!ifs || memcmp(magic, CacheFileMagic, sizeof(magic)) != 0
+       || version != CacheFileVersion || key != contentKey) {
+        return nullptr;
+    }
+
+    auto panels = std::make_shared<Panels>();
+    panels->sn.resize(n);
+    panels->g.resize(n);
+    ifs.read(reinterpret_cast<char*>(panels->sn.data()), sizeof(Vector3) * n);
+    ifs.read(reinterpret_cast<char*>(panels->g.data()), sizeof(Vector3) * n);
+    uint32_t resolution = 0;
+    uint32_t numAreas = 0;
+    ifs.read(reinterpret_cast<char*>(&resolution), sizeof(resolution));
+    ifs.read(reinterpret_cast<char*>(&numAreas), sizeof(numAreas));
+    if(!ifs) {
+        return nullptr;
+    }
+    panels->exposureResolution = resolution;
+    panels->exposure.resize(numAreas);
+    ifs.read(reinterpret_cast<char*>(panels->exposure.data()), sizeof(double) * numAreas);
+    uint32_t numHullVertices = 0;
+    ifs.read(reinterpret_cast<char*>(&numHullVertices), sizeof(numHullVertices));
+    if(!ifs) {
+        return nullptr;
+    }
+    panels->hullVertices.resize(numHullVertices);
+    ifs.read(reinterpret_cast<char*>(panels->hullVertices.data()), sizeof(Vector3) * numHullVertices);
+    if(!ifs) {
+        return nullptr;
+    }
+    return panels;
+}
+
+
+bool DragPanelCache::Impl::savePanels(uint64_t contentKey, const Panels& panels)
+{
+    filesystem::path path = cacheFilePath(contentKey);
+    if(path.empty()) {
+        return false;
+    }
+    try {
+        filesystem::path dirPath(path.parent_path());
+        if(!filesystem::exists(dirPath)) {
+            filesystem::create_directories(dirPath);
+        }
+    }
+    catch(const std::exception&) {
+        return false;
+    }
+
+    std::ofstream ofs(path.string(), ios::binary | ios::trunc);
+    if(!ofs) {
+        return false;
+    }
+    uint32_t n = panels.sn.size();
+    ofs.write(CacheFileMagic, sizeof(CacheFileMagic));
+    ofs.write(reinterpret_cast<const char*>(&CacheFileVersion), sizeof(CacheFileVersion));
+    ofs.write(reinterpret_cast<const char*>(&contentKey), sizeof(contentKey));
+    ofs.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    ofs.write(reinterpret_cast<const char*>(panels.sn.data()), sizeof(Vector3) * n);
+    ofs.write(reinterpret_cast<const char*>(panels.g.data()), sizeof(Vector3) * n);
+    uint32_t resolution = panels.exposureResolution;
+    uint32_t numAreas = panels.exposure.size();
+    ofs.write(reinterpret_cast<const char*>(&resolution), sizeof(resolution));
+    ofs.write(reinterpret_cast<const char*>(&numAreas), sizeof(numAreas));
+    ofs.write(reinterpret_cast<const char*>(panels.exposure.data()), sizeof(double) * numAreas);
+    uint32_t numHullVertices = panels.hullVertices.size();
+    ofs.write(reinterpret_cast<const char*>(&numHullVertices), sizeof(numHullVertices));
+    ofs.write(reinterpret_cast<const char*>(panels.hullVertices.data()), sizeof(Vector3) * numHullVertices);
+    return static_cast<bool>(ofs);
+}
+
+
+void DragPanelCache::Impl::removeExpiredEntries()
+{
+    for(auto p = shapeEntries.begin(); p != shapeEntries.end(); ) {
+        if(p->second.shape.expired()) {
+            p = shapeEntries.erase(p);
+        } else {
+            ++p;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_DRAG_PANEL_CACHE_H
+#define CNOID_CFD_PLUGIN_DRAG_PANEL_CACHE_H
+
+#include <cnoid/EigenTypes>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cnoid {
+
+class SgNode;
+
+/**
+   Session-wide cache of the drag panels extracted from collision shapes.
+   Panels are looked up by the identity of the shape node first and by a hash
+   of the mesh contents second, so that unchanged bodies skip the extraction
+   even when the simulation clones their shapes. The content-keyed entries can
+   optionally be kept on disk across sessions.
+*/
+class DragPanelCache
+{
+public:
+    struct Panels {
+        std::vector<Vector3> sn;
+        std::vector<Vector3> g;
+        // cube map of the projected areas built by DragExposureTable
+        int exposureResolution = 0;
+        std::vector<double> exposure;
+        // triangles of the closed mesh used for the partial buoyancy
+        std::vector<Vector3> hullVertices;
+    };
+    typedef std::shared_ptr<const Panels> PanelsPtr;
+
+    static DragPanelCache* instance();
+
+    void setDiskCacheEnabled(bool on);
+    bool isDiskCacheEnabled() const;
+    void clear();
+
+    /**
+       @param fileTime modification time of the file the shape was loaded from.
+       Entries registered with another time are regarded as stale.
+       @param parameterKey hash of the extraction parameters
+       @param calcPanels function computing the panels on a cache miss
+    */
+    PanelsPtr getPanels(SgNode* shape, std::time_t fileTime, uint64_t parameterKey,
+                        const std::function<PanelsPtr()>& calcPanels);
+
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+private:
+    DragPanelCache();
+    ~DragPanelCache();
+
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_DRAG_PANEL_CACHE_H
@@ -0,0 +1,150 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "DragPanelSet.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef Eigen::Map<const Eigen::ArrayXd> ConstArrayMap;
+
+const int MaxCellResolution = 256;
+
+// Index of the cube map cell containing the direction
+int directionCell(const Vector3& n, int resolution)
+{
+    int axis;
+    n.cwiseAbs().maxCoeff(&axis);
+    const double m = n[axis];
+    const int face = axis * 2 + (m < 0.0 ? 1 : 0);
+    const double u = n[(axis + 1) % 3] / fabs(m);
+    const double v = n[(axis + 2) % 3] / fabs(m);
+    const int i = std::min(resolution - 1, (int)((u + 1.0) * 0.5 * resolution));
+    const int j = std::min(resolution - 1, (int)((v + 1.0) * 0.5 * resolution));
+    return (face * resolution + i) * resolution + j;
+}
+
+int mergePanels(const vector<Vector3>& sn, const vector<Vector3>& g, int resolution,
+                vector<Vector3>& out_sn, vector<Vector3>& out_g)
+{
+    unordered_map<int, int> cellToPanel;
+    vector<double> weights;
+    out_sn.clear();
+    out_g.clear();
+
+    for(size_t i = 0; i < sn.size(); ++i) {
+        const double area = sn[i].norm();
+        if(area <= 0.0) {
+            continue;
+        }
+        int cell = directionCell(sn[i] / area, resolution);
+        auto inserted = cellToPanel.emplace(cell, out_sn.size());
+        if(inserted.second) {
+            out_sn.push_back(sn[i]);
+            out_g.push_back(g[i] * area);
+            weights.push_back(area);
+        } else {
+            int index = inserted.first->second;
+            out_sn[index] += sn[i];
+            out_g[index] += g[i] * area;
+            weights[index] += area;
+        }
+    }
+    for(size_t i = 0; i < out_g.size(); ++i) {
+        out_g[i] /= weights[i];
+    }
+    return out_sn.size();
+}
+
+}
+
+
+DragPanelSet::DragPanelSet()
+{
+    clear();
+}
+
+
+void DragPanelSet::clear()
+{
+    snx.clear();
+    sny.clear();
+    snz.clear();
+    gx.clear();
+    gy.clear();
+    gz.clear();
+}
+
+
+void DragPanelSet::reserve(int n)
+{
+    snx.reserve(n);
+    sny.reserve(n);
+    snz.reserve(n);
+    gx.reserve(n);
+    gy.reserve(n);
+    gz.reserve(n);
+}
+
+
+void DragPanelSet::addPanel(const Vector3& sn, const Vector3& g)
+{
+    snx.push_back(sn.x());
+    sny.push_back(sn.y());
+    snz.push_back(sn.z());
+    gx.push_back(g.x());
+    gy.push_back(g.y());
+    gz.push_back(g.z());
+}
+
+
+double DragPanelSet::projectedArea(const Vector3& direction) const
+{
+    const int n = numPanels();
+    if(n == 0) {
+        return 0.0;
+    }
+
+    // A single fused expression lets Eigen evaluate all the panels
+    // with packet (SSE/AVX) instructions without temporaries.
+    ConstArrayMap x(snx.data(), n);
+    ConstArrayMap y(sny.data(), n);
+    ConstArrayMap z(snz.data(), n);
+    return (x * direction.x() + y * direction.y() + z * direction.z()).max(0.0).sum();
+}
+
+
+namespace cnoid {
+
+int clusterDragPanels(vector<Vector3>& sn, vector<Vector3>& g, double angleTolerance, int maxNumPanels)
+{
+    if(angleTolerance <= 0.0 && maxNumPanels <= 0) {
+        return sn.size();
+    }
+
+    // the angular width of a cell is about 2 / resolution at the face centers
+    int resolution = MaxCellResolution;
+    if(angleTolerance > 0.0) {
+        resolution = std::min(MaxCellResolution, std::max(1, (int)ceil(2.0 / angleTolerance)));
+    }
+
+    vector<Vector3> merged_sn;
+    vector<Vector3> merged_g;
+    int numPanels = mergePanels(sn, g, resolution, merged_sn, merged_g);
+    while(maxNumPanels > 0 && numPanels > maxNumPanels && resolution > 1) {
+        resolution = std::max(1, resolution * 3 / 4);
+        numPanels = mergePanels(sn, g, resolution, merged_sn, merged_g);
+    }
+
+    sn.swap(merged_sn);
+    g.swap(merged_g);
+    return numPanels;
+}
+
+}
\ No newline at end of file
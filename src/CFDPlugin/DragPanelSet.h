@@ -0,0 +1,55 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_DRAG_PANEL_SET_H
+#define CNOID_CFD_PLUGIN_DRAG_PANEL_SET_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Drag panels of a link packed as a structure of arrays.
+   Each panel is the area-weighted normal (sn) and the centroid (g)
+   of a triangle in the link-local frame.
+*/
+class CNOID_EXPORT DragPanelSet
+{
+public:
+    DragPanelSet();
+
+    void clear();
+    void reserve(int n);
+    void addPanel(const Vector3& sn, const Vector3& g);
+
+    int numPanels() const { return static_cast<int>(snx.size()); }
+    bool empty() const { return snx.empty(); }
+    Vector3 normal(int index) const { return Vector3(snx[index], sny[index], snz[index]); }
+    Vector3 centroid(int index) const { return Vector3(gx[index], gy[index], gz[index]); }
+
+    // Sum of max(0, direction . sn) over all the panels.
+    // The direction must be given in the link-local frame.
+    double projectedArea(const Vector3& direction) const;
+
+private:
+    std::vector<double> snx, sny, snz;
+    std::vector<double> gx, gy, gz;
+};
+
+/**
+   Merges the panels whose normals fall into the same direction cell into
+   one equivalent panel holding the sum of their area-weighted normals and
+   their area-weighted centroid. The cells are no wider than angleTolerance
+   [rad] and are coarsened further until at most maxNumPanels panels remain.
+   A non-positive value disables the corresponding criterion.
+   @return the number of the panels after the merge
+*/
+int clusterDragPanels(std::vector<Vector3>& sn, std::vector<Vector3>& g,
+                      double angleTolerance, int maxNumPanels);
+
+}
+
+#endif // CNOID_CFD_PLUGIN_DRAG_PANEL_SET_H
@@ -19,6 +19,8 @@ FlightEvent::FlightEvent()
     name_  = "";
     mass_ = 0.0;
     duration_ = 0.0;
+    beginTime_ = 0.0;
+    endTime_ = 0.0;
 }
 
 FlightEvent::FlightEvent(const FlightEvent& org)
@@ -26,6 +28,8 @@ FlightEvent::FlightEvent(const FlightEvent& org)
     name_ = org.name_;
     mass_ = org.mass_;
     duration_ = org.duration_;
+    beginTime_ = org.beginTime_;
+    endTime_ = org.endTime_;
 }
 
 class FlightEventReader::Impl
@@ -100,6 +104,8 @@ bool FlightEventReader::Impl::load(const string& filename, ostream& os)
 
                     event.setMass(node->get("mass", 0.0));
                     event.setDuration(node->get("duration", 0.0));
+                    event.setBeginTime(node->get("begin_time", 0.0));
+                    event.setEndTime(node->get("end_time", 0.0));
 
                     event.setName(node->get("name", ""));
 
@@ -22,11 +22,18 @@ public:
     void setMass(const double& mass) { mass_ = mass; }
     double duration() const { return duration_; }
     void setDuration(const double& duration) { duration_ = duration; }
+    double beginTime() const { return beginTime_; }
+    void setBeginTime(const double& beginTime) { beginTime_ = beginTime; }
+    // the event lasts indefinitely unless the end time is after the begin time
+    double endTime() const { return endTime_; }
+    void setEndTime(const double& endTime) { endTime_ = endTime; }
 
 private:
     std::string name_;
     double mass_;
     double duration_;
+    double beginTime_;
+    double endTime_;
 };
 
 class FlightEventReader
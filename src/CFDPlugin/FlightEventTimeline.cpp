@@ -0,0 +1,90 @@
+/**
+    @author Kenta Suzuki
+*/
+
+#include "FlightEventTimeline.h"
+#include <algorithm>
+#include <set>
+
+using namespace std;
+using namespace cnoid;
+
+
+FlightEventTimeline::FlightEventTimeline(const vector<FlightEvent>& flightEvents)
+    : events(flightEvents)
+{
+    // an event begins at its begin time and ends at its end time if it is after the begin time
+    vector<Edge> edges;
+    for(size_t i = 0; i < events.size(); ++i) {
+        const FlightEvent& event = events[i];
+        edges.push_back({ event.beginTime(), (int)i, true });
+        if(event.endTime() > event.beginTime()) {
+            edges.push_back({ event.endTime(), (int)i, false });
+        }
+    }
+    std::sort(edges.begin(), edges.end(),
+              [](const Edge& a, const Edge& b){ return a.time < b.time; });
+
+    // the active events ordered by mass, and by the file order among the same masses
+    set<pair<double, int>> activeEvents;
+
+    // each interval starts at a boundary and lasts until the next one
+    for(size_t i = 0; i < edges.size(); ) {
+        const double time = edges[i].time;
+        for(; i < edges.size() && edges[i].time == time; ++i) {
+            const Edge& edge = edges[i];
+            const pair<double, int> key(events[edge.event].mass(), edge.event);
+            if(edge.isBegin) {
+                activeEvents.insert(key);
+            } else {
+                activeEvents.erase(key);
+            }
+        }
+
+        boundaries.push_back(time);
+        intervals.push_back(Interval());
+        Interval& interval = intervals.back();
+        const int n = activeEvents.size();
+        interval.masses.resize(n);
+        interval.latestEvents.resize(n);
+        int k = n;
+        int latest = -1;
+        for(auto it = activeEvents.rbegin(); it != activeEvents.rend(); ++it) {
+            --k;
+            interval.masses[k] = it->first;
+            latest = std::max(latest, it->second);
+            interval.latestEvents[k] = latest;
+        }
+    }
+}
+
+
+const FlightEventTimeline::Interval* FlightEventTimeline::findInterval(double time) const
+{
+    auto it = std::upper_bound(boundaries.begin(), boundaries.end(), time);
+    if(it == boundaries.begin()) {
+        return nullptr;
+    }
+    return &intervals[it - boundaries.begin() - 1];
+}
+
+
+const FlightEvent* FlightEventTimeline::findEvent(double mass, double time) const
+{
+    const Interval* interval = findInterval(time);
+    if(!interval) {
+        return nullptr;
+    }
+    auto it = std::upper_bound(interval->masses.begin(), interval->masses.end(), mass);
+    if(it == interval->masses.end()) {
+        return nullptr;
+    }
+    return &events[interval->latestEvents[it - interval->masses.begin()]];
+}
+
+
+double FlightEventTimeline::nextChangeTime(double time) const
+{
+    auto it = std::upper_bound(boundaries.begin(), boundaries.end(), time);
+    return it != boundaries.end() ? *it : -1.0;
+}
@@ -0,0 +1,62 @@
+/**
+    @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_FLIGHT_EVENT_TIMELINE_H
+#define CNOID_CFD_PLUGIN_FLIGHT_EVENT_TIMELINE_H
+
+#include <memory>
+#include <vector>
+#include "FlightEventReader.h"
+
+namespace cnoid {
+
+/**
+   Flight events compiled into the intervals between their begin and end
+   times. The events active in each interval are sorted by mass, so finding
+   the event applied to a body is a binary search on the time followed by a
+   binary search on the mass. When several events match, the one appearing
+   last in the file takes precedence as in the scan of the event list.
+   The intervals are built in one sweep over the sorted begin and end times.
+*/
+class FlightEventTimeline
+{
+public:
+    FlightEventTimeline(const std::vector<FlightEvent>& flightEvents);
+
+    bool empty() const { return events.empty(); }
+    int numEvents() const { return events.size(); }
+    const FlightEvent& event(int index) const { return events[index]; }
+
+    // Event applied to a body lighter than its mass at the time, or nullptr
+    const FlightEvent* findEvent(double mass, double time) const;
+
+    // Time when the set of the active events changes next, or a negative value
+    double nextChangeTime(double time) const;
+
+private:
+    struct Interval {
+        // masses of the active events in the ascending order
+        std::vector<double> masses;
+        // the last event in the file order among the events from the index to the end
+        std::vector<int> latestEvents;
+    };
+
+    struct Edge {
+        double time;
+        int event;
+        bool isBegin;
+    };
+
+    const Interval* findInterval(double time) const;
+
+    std::vector<FlightEvent> events;
+    std::vector<double> boundaries;
+    std::vector<Interval> intervals;
+};
+
+typedef std::shared_ptr<const FlightEventTimeline> FlightEventTimelinePtr;
+
+}
+
+#endif // CNOID_CFD_PLUGIN_FLIGHT_EVENT_TIMELINE_H
@@ -0,0 +1,289 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "FlowFieldGrid.h"
+#include <cnoid/Format>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const char FileMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'F', 'L', 'W' };
+const uint32_t FileVersion = 1;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nx;
+    uint32_t ny;
+    uint32_t nz;
+    uint32_t numFrames;
+    double origin[3];
+    double spacing[3];
+    double timeStep;
+};
+
+const size_t HeaderSize = 8 + 4 * 5 + 8 * 7;
+
+std::mutex registryMutex;
+unordered_map<string, weak_ptr<FlowFieldGrid>> registry;
+
+}
+
+namespace cnoid {
+
+class FlowFieldGrid::Impl
+{
+public:
+    Impl();
+    ~Impl();
+
+    bool open(const string& filename, string& out_errorMessage);
+
+    string filename;
+    QFile file;
+    const uchar* data;
+    int nx;
+    int ny;
+    int nz;
+    int numFrames;
+    Vector3 origin;
+    Vector3 spacing;
+    double timeStep;
+    size_t frameSize;
+};
+
+}
+
+
+FlowFieldGridPtr FlowFieldGrid::open(const string& filename, string& out_errorMessage)
+{
+    QFileInfo info(filename.c_str());
+    string key = info.canonicalFilePath().toStdString();
+    if(key.empty()) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" does not exist."), filename);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    auto p = registry.find(key);
+    if(p != registry.end()) {
+        if(auto grid = p->second.lock()) {
+            return grid;
+        }
+    }
+
+    FlowFieldGridPtr grid(new FlowFieldGrid);
+    if(!grid->impl->open(key, out_errorMessage)) {
+        return nullptr;
+    }
+    registry[key] = grid;
+    return grid;
+}
+
+
+FlowFieldGrid::FlowFieldGrid()
+{
+    impl = new Impl;
+}
+
+
+FlowFieldGrid::Impl::Impl()
+    : data(nullptr),
+      nx(0),
+      ny(0),
+      nz(0),
+      numFrames(0),
+      origin(Vector3::Zero()),
+      spacing(Vector3::Ones()),
+      timeStep(0.0),
+      frameSize(0)
+{
+
+}
+
+
+FlowFieldGrid::~FlowFieldGrid()
+{
+    delete impl;
+}
+
+
+FlowFieldGrid::Impl::~Impl()
+{
+    if(data) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+    file.close();
+}
+
+
+bool FlowFieldGrid::Impl::open(const string& filename, string& out_errorMessage)
+{
+    this->filename = filename;
+    file.setFileName(filename.c_str());
+    if(!file.open(QIODevice::ReadOnly)) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" cannot be opened."), filename);
+        return false;
+    }
+
+    FileHeader header;
+    qint64 fileSize = file.size();
+    if(fileSize < (qint64)HeaderSize) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" is broken."), filename);
+        return false;
+    }
+
+    // The whole file is mapped read-only so that the pages are loaded on demand
+    // and shared with any other process or grid mapping the same file.
+    data = file.map(0, fileSize);
+    if(!data) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" cannot be mapped."), filename);
+        return false;
+    }
+
+    const uchar* q = data;
+    memcpy(header.magic, q, 8); q += 8;
+    memcpy(&header.version, q, 4); q += 4;
+    memcpy(&header.nx, q, 4); q += 4;
+    memcpy(&header.ny, q, 4); q += 4;
+    memcpy(&header.nz, q, 4); q += 4;
+    memcpy(&header.numFrames, q, 4); q += 4;
+    memcpy(header.origin, q, 24); q += 24;
+    memcpy(header.spacing, q, 24); q += 24;
+    memcpy(&header.timeStep, q, 8);
+
+    if(memcmp(header.magic, FileMagic, 8) != 0 || header.version != FileVersion) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" is not a supported format."), filename);
+        return false;
+    }
+    if(header.nx < 1 || header.ny < 1 || header.nz < 1 || header.numFrames < 1
+       || header.spacing[0] <= 0.0 || header.spacing[1] <= 0.0 || header.spacing[2] <= 0.0) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" is broken."), filename);
+        return false;
+    }
+
+    nx = header.nx;
+    ny = header.ny;
+    nz = header.nz;
+    numFrames = header.numFrames;
+    origin << header.origin[0], header.origin[1], header.origin[2];
+    spacing << header.spacing[0], header.spacing[1], header.spacing[2];
+    timeStep = header.timeStep;
+    frameSize = (size_t)nx * ny * nz * 3;
+
+    qint64 dataSize = (qint64)(frameSize * numFrames * sizeof(float));
+    if(fileSize < (qint64)HeaderSize + dataSize) {
+        out_errorMessage = formatR(_("Flow field file \"{0}\" is broken."), filename);
+        return false;
+    }
+
+    return true;
+}
+
+
+const std::string& FlowFieldGrid::filename() const
+{
+    return impl->filename;
+}
+
+
+int FlowFieldGrid::nx() const
+{
+    return impl->nx;
+}
+
+
+int FlowFieldGrid::ny() const
+{
+    return impl->ny;
+}
+
+
+int FlowFieldGrid::nz() const
+{
+    return impl->nz;
+}
+
+
+int FlowFieldGrid::numFrames() const
+{
+    return impl->numFrames;
+}
+
+
+const Vector3& FlowFieldGrid::origin() const
+{
+    return impl->origin;
+}
+
+
+const Vector3& FlowFieldGrid::spacing() const
+{
+    return impl->spacing;
+}
+
+
+double FlowFieldGrid::timeStep() const
+{
+    return impl->timeStep;
+}
+
+
+const float* FlowFieldGrid::frameData(int frame) const
+{
+    const float* values = reinterpret_cast<const float*>(impl->data + HeaderSize);
+    return values + impl->frameSize * frame;
+}
+
+
+size_t FlowFieldGrid::frameSize() const
+{
+    return impl->frameSize;
+}
+
+
+Vector3 FlowFieldGrid::sample(const Vector3& p, int frame) const
+{
+    return sample(frameData(std::max(0, std::min(frame, impl->numFrames - 1))), p);
+}
+
+
+Vector3 FlowFieldGrid::sample(const float* data, const Vector3& p) const
+{
+    const int n[] = { impl->nx, impl->ny, impl->nz };
+    int i0[3], i1[3];
+    double t[3];
+    for(int k = 0; k < 3; ++k) {
+        double u = (p[k] - impl->origin[k]) / impl->spacing[k];
+        u = std::max(0.0, std::min(u, (double)(n[k] - 1)));
+        i0[k] = std::min((int)floor(u), n[k] - 1);
+        i1[k] = std::min(i0[k] + 1, n[k] - 1);
+        t[k] = u - i0[k];
+    }
+
+    auto value = [&](int x, int y, int z){
+        const float* v = data + (((size_t)z * impl->ny + y) * impl->nx + x) * 3;
+        return Vector3(v[0], v[1], v[2]);
+    };
+
+    Vector3 c00 = value(i0[0], i0[1], i0[2]) * (1.0 - t[0]) + value(i1[0], i0[1], i0[2]) * t[0];
+    Vector3 c10 = value(i0[0], i1[1], i0[2]) * (1.0 - t[0]) + value(i1[0], i1[1], i0[2]) * t[0];
+    Vector3 c01 = value(i0[0], i0[1], i1[2]) * (1.0 - t[0]) + value(i1[0], i0[1], i1[2]) * t[0];
+    Vector3 c11 = value(i0[0], i1[1], i1[2]) * (1.0 - t[0]) + value(i1[0], i1[1], i1[2]) * t[0];
+    Vector3 c0 = c00 * (1.0 - t[1]) + c10 * t[1];
+    Vector3 c1 = c01 * (1.0 - t[1]) + c11 * t[1];
+    return c0 * (1.0 - t[2]) + c1 * t[2];
+}
@@ -0,0 +1,70 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_FLOW_FIELD_GRID_H
+#define CNOID_CFD_PLUGIN_FLOW_FIELD_GRID_H
+
+#include <cnoid/EigenTypes>
+#include <memory>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Regular 3D grid of flow vectors read from a binary file.
+
+   The file consists of the following little-endian header followed by
+   numFrames * nz * ny * nx vectors of three float32 values, x varying fastest.
+
+   - char[8]    magic "CNOIDFLW"
+   - uint32     version (1)
+   - uint32     nx, ny, nz
+   - uint32     numFrames
+   - float64[3] origin
+   - float64[3] spacing
+   - float64    timeStep
+
+   The file is memory-mapped instead of being read, so grids larger than the
+   physical memory can be used and the pages are shared by all the grids
+   opening the same file.
+*/
+class CNOID_EXPORT FlowFieldGrid
+{
+public:
+    // Returns the grid of the file, sharing it with the other users of the file
+    static std::shared_ptr<FlowFieldGrid> open(const std::string& filename, std::string& out_errorMessage);
+
+    ~FlowFieldGrid();
+
+    const std::string& filename() const;
+    int nx() const;
+    int ny() const;
+    int nz() const;
+    int numFrames() const;
+    const Vector3& origin() const;
+    const Vector3& spacing() const;
+    double timeStep() const;
+
+    const float* frameData(int frame) const;
+    size_t frameSize() const;
+
+    // Trilinear interpolation of the flow at the point given in the grid frame.
+    // Points outside of the grid are clamped to the nearest boundary cell.
+    Vector3 sample(const Vector3& p, int frame = 0) const;
+    // Same as above for frame data laid out like frameData(), e.g. a copy of a frame
+    Vector3 sample(const float* data, const Vector3& p) const;
+
+private:
+    FlowFieldGrid();
+
+    class Impl;
+    Impl* impl;
+};
+
+typedef std::shared_ptr<FlowFieldGrid> FlowFieldGridPtr;
+
+}
+
+#endif // CNOID_CFD_PLUGIN_FLOW_FIELD_GRID_H
@@ -0,0 +1,244 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "FlowFieldStream.h"
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class FlowFieldStream::Impl
+{
+public:
+    Impl(FlowFieldGridPtr grid, bool isLoopEnabled);
+    ~Impl();
+
+    int frameIndex(long step) const;
+    void loadFrame(int frame, vector<float>& buffer);
+    void acquireFrame(int frame, int& slot);
+    void requestPrefetch(int frame);
+    void load();
+    void update(double time);
+
+    FlowFieldGridPtr grid;
+    bool isLoopEnabled;
+    bool isStreaming;
+
+    // buffers[current] and buffers[next] hold the frames of currentStep and
+    // currentStep + 1, and buffers[prefetch] is filled by the loader thread.
+    // frames[] are the frame indices in the buffers, which is -1 for the
+    // prefetch buffer while the loader writes it
+    vector<float> buffers[3];
+    int frames[3];
+    int current;
+    int next;
+    int prefetch;
+    long currentStep;
+    double ratio;
+
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable condition;
+    int requestedFrame;
+    int loadingFrame;
+    bool isExiting;
+};
+
+}
+
+
+FlowFieldStream::FlowFieldStream(FlowFieldGridPtr grid, bool isLoopEnabled)
+{
+    impl = new Impl(grid, isLoopEnabled);
+}
+
+
+FlowFieldStream::Impl::Impl(FlowFieldGridPtr grid, bool isLoopEnabled)
+    : grid(grid),
+      isLoopEnabled(isLoopEnabled),
+      current(0),
+      next(1),
+      prefetch(2),
+      currentStep(0),
+      ratio(0.0),
+      requestedFrame(-1),
+      loadingFrame(-1),
+      isExiting(false)
+{
+    frames[0] = frames[1] = frames[2] = -1;
+    isStreaming = grid->numFrames() > 1 && grid->timeStep() > 0.0;
+    if(isStreaming) {
+        frames[current] = frameIndex(0);
+        loadFrame(frames[current], buffers[current]);
+        frames[next] = frameIndex(1);
+        loadFrame(frames[next], buffers[next]);
+        loader = std::thread([this](){ load(); });
+        requestPrefetch(frameIndex(2));
+    }
+}
+
+
+FlowFieldStream::~FlowFieldStream()
+{
+    delete impl;
+}
+
+
+FlowFieldStream::Impl::~Impl()
+{
+    if(loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isExiting = true;
+        }
+        condition.notify_all();
+        loader.join();
+    }
+}
+
+
+FlowFieldGrid* FlowFieldStream::grid() const
+{
+    return impl->grid.get();
+}
+
+
+int FlowFieldStream::Impl::frameIndex(long step) const
+{
+    const int numFrames = grid->numFrames();
+    if(isLoopEnabled) {
+        return step % numFrames;
+    }
+    return std::min(step, (long)numFrames - 1);
+}
+
+
+void FlowFieldStream::Impl::loadFrame(int frame, vector<float>& buffer)
+{
+    // Copying the frame out of the mapping reads its pages from the disk
+    buffer.resize(grid->frameSize());
+    memcpy(buffer.data(), grid->frameData(frame), sizeof(float) * buffer.size());
+}
+
+
+// Puts the frame into buffers[slot], taking the prefetched buffer if it holds the frame
+// and copying the frame out of the file otherwise
+void FlowFieldStream::Impl::acquireFrame(int frame, int& slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(frames[prefetch] == frame) {
+            std::swap(slot, prefetch);
+            return;
+        }
+    }
+    frames[slot] = frame;
+    loadFrame(frame, buffers[slot]);
+}
+
+
+void FlowFieldStream::Impl::requestPrefetch(int frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // a clamped stream stays on the last frame, which is not loaded again
+        if(frame == frames[current] || frame == frames[next] || frame == frames[prefetch]
+           || frame == loadingFrame) {
+            requestedFrame = -1;
+            return;
+        }
+        requestedFrame = frame;
+    }
+    condition.notify_all();
+}
+
+
+void FlowFieldStream::Impl::load()
+{
+    while(true) {
+        int frame;
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&](){ return isExiting || requestedFrame >= 0; });
+            if(isExiting) {
+                break;
+            }
+            frame = requestedFrame;
+            requestedFrame = -1;
+            // the buffer is not taken by the dynamics thread while its frame is -1
+            slot = prefetch;
+            frames[slot] = -1;
+            loadingFrame = frame;
+        }
+
+        loadFrame(frame, buffers[slot]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames[slot] = frame;
+            loadingFrame = -1;
+        }
+    }
+}
+
+
+void FlowFieldStream::update(double time)
+{
+    if(impl->isStreaming) {
+        impl->update(time);
+    }
+}
+
+
+void FlowFieldStream::Impl::update(double time)
+{
+    const double t = std::max(0.0, time / grid->timeStep());
+    const long step = (long)floor(t);
+    ratio = t - step;
+    if(step == currentStep) {
+        return;
+    }
+
+    // The stream jumps to the step even if the frames are shorter than the time step
+    // or the time goes back. The prefetched frame is used when it is the needed one,
+    // and the frames are copied out of the file synchronously otherwise.
+    currentStep = step;
+    const int frame0 = frameIndex(step);
+    const int frame1 = frameIndex(step + 1);
+    if(frame0 != frames[current]) {
+        if(frame0 == frames[next]) {
+            std::swap(current, next);
+        } else {
+            acquireFrame(frame0, current);
+        }
+    }
+    if(frame1 != frames[next]) {
+        acquireFrame(frame1, next);
+    }
+    requestPrefetch(frameIndex(step + 2));
+}
+
+
+Vector3 FlowFieldStream::sample(const Vector3& p) const
+{
+    if(!impl->isStreaming) {
+        return impl->grid->sample(p);
+    }
+    const FlowFieldGrid* grid = impl->grid.get();
+    const double r = impl->ratio;
+    Vector3 v0 = grid->sample(impl->buffers[impl->current].data(), p);
+    if(r <= 0.0) {
+        return v0;
+    }
+    Vector3 v1 = grid->sample(impl->buffers[impl->next].data(), p);
+    return v0 * (1.0 - r) + v1 * r;
+}
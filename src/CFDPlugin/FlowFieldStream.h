@@ -0,0 +1,45 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_FLOW_FIELD_STREAM_H
+#define CNOID_CFD_PLUGIN_FLOW_FIELD_STREAM_H
+
+#include "FlowFieldGrid.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Plays the frames of a flow field grid back in time.
+   The flow is interpolated linearly between the two frames enclosing the
+   current time, and a loader thread copies the frame following them out of
+   the file in the meantime. If the needed frames have not been prefetched,
+   for example when a frame is shorter than the time step, they are copied
+   out of the file synchronously so that the flow follows the time.
+   A grid with a single frame is sampled directly without the loader thread.
+*/
+class CNOID_EXPORT FlowFieldStream
+{
+public:
+    FlowFieldStream(FlowFieldGridPtr grid, bool isLoopEnabled = false);
+    ~FlowFieldStream();
+
+    FlowFieldGrid* grid() const;
+
+    // Must be called before sampling whenever the time changes
+    void update(double time);
+
+    // Can be called from multiple threads between the updates
+    Vector3 sample(const Vector3& p) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef std::shared_ptr<FlowFieldStream> FlowFieldStreamPtr;
+
+}
+
+#endif // CNOID_CFD_PLUGIN_FLOW_FIELD_STREAM_H
@@ -0,0 +1,295 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "FluidForceEvaluator.h"
+#include <cnoid/ColliderIndex>
+#include <cnoid/ColliderSnapshot>
+#include <cnoid/Link>
+#include <cnoid/MathUtil>
+#include <cnoid/SimpleColliderItem>
+#include <algorithm>
+#include <cmath>
+#include "Rotor.h"
+#include "RotorWakeField.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/*
+  The surface of the fluid in the collider as the plane normal.dot(x) = level in the world frame.
+  The surface of a box is the face facing up the most, which is the local +z face of an upright box,
+  and the one of a standing cylinder is its upper cap. The other shapes take the horizontal
+  plane touching their top.
+*/
+void calcFluidSurface(const ColliderSnapshot& fluid, const Vector3& up, Vector3& out_normal, double& out_level)
+{
+    const Vector3 p = fluid.position.translation();
+    const Matrix3 R = fluid.position.linear();
+    if(fluid.sceneType == SimpleColliderItem::BOX) {
+        int axis = 2;
+        for(int i = 0; i < 2; ++i) {
+            if(fabs(R.col(i).dot(up)) > fabs(R.col(axis).dot(up))) {
+                axis = i;
+            }
+        }
+        out_normal = R.col(axis).dot(up) >= 0.0 ? Vector3(R.col(axis)) : Vector3(-R.col(axis));
+        out_level = out_normal.dot(p) + fluid.size[axis] / 2.0;
+        return;
+    }
+    if(fluid.sceneType == SimpleColliderItem::CYLINDER) {
+        // the cylinder axis is the local Y axis
+        const Vector3 a = R.col(1);
+        if(fabs(a.dot(up)) >= sqrt(0.5)) {
+            out_normal = a.dot(up) >= 0.0 ? a : Vector3(-a);
+            out_level = out_normal.dot(p) + fluid.height / 2.0;
+            return;
+        }
+    }
+    out_normal = up;
+    out_level = up.dot(fluid.shape.support(up));
+}
+
+}
+
+
+FluidLink::FluidLink()
+{
+    link = nullptr;
+    density = 0.0;
+    centerOfBuoyancy << 0.0, 0.0, 0.0;
+    cdw = 0.0;
+    cda = 0.0;
+    cv = 0.0;
+    cw = 0.0;
+    usePackedPanels = false;
+    isPanelDragEnabled = true;
+    f.setZero();
+    tau.setZero();
+}
+
+
+FluidForceEvaluator::FluidForceEvaluator()
+{
+    gravity_ << 0.0, 0.0, -9.80665;
+    colliderIndex = nullptr;
+    flowFields = nullptr;
+    wakeField = nullptr;
+    isBoundaryBlendingEnabled = false;
+}
+
+
+void FluidForceEvaluator::calcLinkForces
+(FluidLink& fluidLink, int owner, vector<const ColliderSnapshot*>& hitColliders, vector<double>& hitWeights) const
+{
+    Link* link = fluidLink.link;
+    const Isometry3& T = link->T();
+    fluidLink.f.setZero();
+    fluidLink.tau.setZero();
+
+    double density = 0.0;
+    double viscosity = 0.0;
+    Vector3 sf = Vector3::Zero();
+    Vector3 c = T * link->centerOfMass();
+    if(isBoundaryBlendingEnabled) {
+        // the properties fade across the boundaries instead of switching
+        colliderIndex->queryBlendWeights(T.translation(), hitColliders, hitWeights);
+    } else {
+        colliderIndex->queryColliders(T.translation(), hitColliders);
+    }
+    for(size_t k = 0; k < hitColliders.size(); ++k) {
+        const ColliderSnapshot* collider = hitColliders[k];
+        auto rot = collider->position.linear();
+        Vector3 f = collider->steadyFlow + collider->unsteadyFlow;
+        if(flowFields && !flowFields->empty()) {
+            auto p = flowFields->find(collider->item);
+            if(p != flowFields->end()) {
+                // the grid is sampled at the center of mass in the collider frame
+                f += p->second->sample(collider->inversePosition * c);
+            }
+        }
+        if(isBoundaryBlendingEnabled) {
+            const double w = hitWeights[k];
+            density += w * collider->density;
+            viscosity += w * collider->viscosity;
+            sf += w * (rot * f);
+        } else {
+            density = collider->density;
+            viscosity = collider->viscosity;
+            sf += rot * f;
+        }
+    }
+
+    // buoyancy
+    if(fluidLink.density > 0.0) {
+        double volume = link->mass() / fluidLink.density;
+        if(!fluidLink.hull.empty()) {
+            calcPartialBuoyancy(fluidLink, volume);
+        } else {
+            Vector3 b = density * gravity_ * volume * -1.0;
+            fluidLink.f += b;
+            Vector3 cb = T * fluidLink.centerOfBuoyancy;
+            fluidLink.tau += cb.cross(b);
+        }
+    }
+
+    //flow
+    fluidLink.f += sf;
+    fluidLink.tau += c.cross(sf);
+
+    //drag
+    double cd = 0.0;
+    if(density > 10.0) {
+        cd = fluidLink.cdw;
+    } else {
+        cd = fluidLink.cda;
+    }
+
+    Vector3 a = link->R() * link->centerOfMass();
+    Vector3 w = link->w();
+    Vector3 v = link->v() + w.cross(a);
+    if(wakeField && !wakeField->empty()) {
+        // the drag acts on the velocity relative to the downwash of the other bodies
+        v -= wakeField->inducedVelocity(c, owner);
+    }
+
+    double v_norm = v.dot(v);
+    double v2 = v_norm * v_norm;
+    // Vector3 v_local = link->R().inverse() * v;
+    Vector3 n = v.normalized();
+    double p = 0.5 * density * v2;
+
+    if(!fluidLink.isPanelDragEnabled) {
+        // the drag table of the wing gives the drag
+    } else if(!fluidLink.exposure.empty()) {
+        // the projected area including the self-shadowing is tabulated
+        // for the flow directions in the link frame
+        Vector3 n_local = link->R().transpose() * n;
+        double s = fluidLink.exposure.projectedArea(n_local);
+        if(s > 0.0) {
+            Vector3 f = p * cd * s * n * -1.0;
+            fluidLink.f += f;
+            fluidLink.tau += c.cross(f);
+        }
+    } else if(fluidLink.usePackedPanels) {
+        // rotate the flow direction into the link frame once
+        // instead of rotating every panel into the world frame
+        Vector3 n_local = link->R().transpose() * n;
+        double s = fluidLink.panels.projectedArea(n_local);
+        if(s > 0.0) {
+            Vector3 f = p * cd * s * n * -1.0;
+            fluidLink.f += f;
+            fluidLink.tau += c.cross(f);
+        }
+    } else {
+        for(int k = 0; k < fluidLink.sn.size(); ++k) {
+            Vector3 sn = link->R() * fluidLink.sn[k];
+            double s = n.dot(sn);
+            if(s > 0.0) {
+                Vector3 f = p * cd * s * n * -1.0;
+                fluidLink.f += f;
+                fluidLink.tau += c.cross(f);
+                Vector3 g = T * fluidLink.g[k];
+                // fluidLink.tau += g.cross(f);
+            }
+        }
+    }
+
+    //viscous drag
+    Vector3 fv = fluidLink.cv * viscosity * v * -1.0;
+    Vector3 tv = fluidLink.cw * viscosity * w * -1.0;
+    fluidLink.f += fv;
+    fluidLink.tau += c.cross(fv) + tv;
+}
+
+
+void FluidForceEvaluator::calcPartialBuoyancy(FluidLink& fluidLink, double volume) const
+{
+    Link* link = fluidLink.link;
+    const Isometry3& T = link->T();
+    const double g = gravity_.norm();
+    if(g <= 0.0) {
+        return;
+    }
+    const Vector3 up = gravity_ / -g;
+
+    // The fluid is the densest collider containing the center or the lowest vertex of the hull,
+    // so a body reaching below the floor of a shallow fluid still floats in it.
+    const Vector3 up_local = link->R().transpose() * up;
+    const Vector3 probes[2] = { T * fluidLink.hull.center(), T * fluidLink.hull.support(-up_local) };
+    const ColliderSnapshot* fluid = nullptr;
+    for(auto& probe : probes) {
+        colliderIndex->queryColliders(probe, fluidLink.fluidColliders);
+        for(auto& collider : fluidLink.fluidColliders) {
+            if(!fluid || collider->density > fluid->density) {
+                fluid = collider;
+            }
+        }
+    }
+    if(!fluid) {
+        return;
+    }
+    Vector3 normal;
+    double level;
+    calcFluidSurface(*fluid, up, normal, level);
+
+    // the surface in the link frame
+    const Vector3 normal_local = link->R().transpose() * normal;
+    const double level_local = level - normal.dot(T.translation());
+    Vector3 center;
+    double submergedVolume = fluidLink.hull.calcSubmergedVolume(normal_local, level_local, center);
+    if(submergedVolume <= 0.0) {
+        return;
+    }
+
+    Vector3 b = fluid->density * gravity_ * volume * (submergedVolume / fluidLink.hull.volume()) * -1.0;
+    fluidLink.f += b;
+    Vector3 cb = T * center;
+    fluidLink.tau += cb.cross(b);
+}
+
+
+double FluidForceEvaluator::calcRotorThrust(Rotor* rotor, double voltage) const
+{
+    Link* link = rotor->link();
+    double n = rotor->kv() * voltage;
+    double d3 = rotor->diameter() / 10.0;
+    double p1 = rotor->pitch() / 10.0;
+    double k = rotor->k();
+    double g = fabs(gravity_[2]);
+    if(n <= 0.0) {
+        n = link->dq_target() * 30.0 / PI;
+    } else {
+        double dir = 1.0;
+        if(rotor->reverse()) {
+            dir *= -1.0;
+        }
+        link->dq_target() = n * PI / 30.0 * dir;
+    }
+    double n2 = n / 1000.0;
+    return k * d3 * d3 * d3 * p1 * n2 * n2 * g / 1000.0;
+}
+
+
+double FluidForceEvaluator::calcRotorWake
+(const Rotor* rotor, int owner, const Vector3& p, const Vector3& thrustAxis, double density, double thrust) const
+{
+    const double radius = rotor->diameter() * 0.0254 / 2.0;
+    const double area = PI * radius * radius;
+    if(area <= 0.0 || !wakeField) {
+        return thrust;
+    }
+
+    // Momentum theory induced velocity of the isolated rotor.
+    // The downwash of the other rotors passing through the disk reduces the
+    // angle of attack of the blades, and the ground below the disk increases the thrust.
+    const double inducedVelocity = sqrt(thrust / (2.0 * density * area));
+    const double inflow = -thrustAxis.dot(wakeField->inducedVelocity(p, owner));
+    if(inflow > 0.0) {
+        thrust *= std::max(0.0, 1.0 - inflow / (2.0 * inducedVelocity));
+    }
+    const double distance = wakeField->obstacleDistance(p, -thrustAxis);
+    return thrust * RotorWakeField::groundEffectRatio(radius, distance);
+}
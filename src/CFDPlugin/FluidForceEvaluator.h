@@ -0,0 +1,114 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_FLUID_FORCE_EVALUATOR_H
+#define CNOID_CFD_PLUGIN_FLUID_FORCE_EVALUATOR_H
+
+#include <cnoid/EigenTypes>
+#include <unordered_map>
+#include <vector>
+#include "DragExposureTable.h"
+#include "DragPanelSet.h"
+#include "FlowFieldStream.h"
+#include "ImmersionHull.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ColliderIndex;
+class Link;
+class MultiColliderItem;
+class Rotor;
+class RotorWakeField;
+struct ColliderSnapshot;
+
+/**
+   Fluid parameters and drag geometry of a link, and the force and the torque
+   evaluated on it in the last step.
+*/
+struct CNOID_EXPORT FluidLink
+{
+    FluidLink();
+
+    Link* link;
+    double density;
+    Vector3 centerOfBuoyancy;
+    double cdw;
+    double cda;
+    double cv;
+    double cw;
+    bool usePackedPanels;
+    // false for a wing whose drag table gives the drag of the link instead of the panels
+    bool isPanelDragEnabled;
+    // the drag panels in one of the layouts, and the exposure table preferred to them
+    std::vector<Vector3> sn;
+    std::vector<Vector3> g;
+    DragPanelSet panels;
+    DragExposureTable exposure;
+    // the closed mesh for the partial buoyancy, which is empty to use the whole volume
+    ImmersionHull hull;
+    std::vector<const ColliderSnapshot*> fluidColliders;
+    Vector3 f;
+    Vector3 tau;
+};
+
+/**
+   Forces of the fluid colliders on the links and the thrust of the rotors.
+   The evaluation only reads the links, the snapshots in the collider index,
+   the flow fields and the wake field, so it does not depend on the items
+   and runs on the links of different bodies in parallel. The simulator item
+   and the benchmark share it to evaluate the same model.
+*/
+class CNOID_EXPORT FluidForceEvaluator
+{
+public:
+    typedef std::unordered_map<MultiColliderItem*, FlowFieldStreamPtr> FlowFieldMap;
+
+    FluidForceEvaluator();
+
+    void setGravity(const Vector3& gravity) { gravity_ = gravity; }
+    void setColliderIndex(const ColliderIndex* colliderIndex) { this->colliderIndex = colliderIndex; }
+    // The flow fields of the colliders, or nullptr
+    void setFlowFields(const FlowFieldMap* flowFields) { this->flowFields = flowFields; }
+    // The downwash the drag is relative to, or nullptr
+    void setWakeField(const RotorWakeField* wakeField) { this->wakeField = wakeField; }
+    void setBoundaryBlendingEnabled(bool on) { isBoundaryBlendingEnabled = on; }
+
+    /**
+       Sets the buoyancy, the flow force, the drag and the viscous drag of the link to
+       fluidLink.f and fluidLink.tau.
+       @param owner index of the body of the link, whose own downwash is ignored
+       @param hitColliders, hitWeights buffers for the collider queries reused over the calls
+    */
+    void calcLinkForces(FluidLink& fluidLink, int owner, std::vector<const ColliderSnapshot*>& hitColliders,
+                        std::vector<double>& hitWeights) const;
+
+    /**
+       Static thrust of the rotor driven at the voltage. The rotor link is driven at the
+       speed given by the voltage, and the speed of the link gives the thrust without it.
+    */
+    double calcRotorThrust(Rotor* rotor, double voltage) const;
+
+    /**
+       The thrust of the rotor at the position reduced by the downwash of the other bodies
+       passing through its disk and increased by the ground below it.
+       @param owner index of the body of the rotor
+       @param thrustAxis unit direction of the thrust
+    */
+    double calcRotorWake(const Rotor* rotor, int owner, const Vector3& p, const Vector3& thrustAxis,
+                         double density, double thrust) const;
+
+private:
+    void calcPartialBuoyancy(FluidLink& fluidLink, double volume) const;
+
+    Vector3 gravity_;
+    const ColliderIndex* colliderIndex;
+    const FlowFieldMap* flowFields;
+    const RotorWakeField* wakeField;
+    bool isBoundaryBlendingEnabled;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_FLUID_FORCE_EVALUATOR_H
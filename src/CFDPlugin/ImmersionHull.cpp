@@ -0,0 +1,238 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "ImmersionHull.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double MarginRatio = 0.1;
+
+double tetrahedronVolume(const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3)
+{
+    return fabs((p1 - p0).dot((p2 - p0).cross(p3 - p0))) / 6.0;
+}
+
+void addTetrahedron(const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3,
+                    double& io_volume, Vector3& io_moment)
+{
+    double v = tetrahedronVolume(p0, p1, p2, p3);
+    io_volume += v;
+    io_moment += v * (p0 + p1 + p2 + p3) / 4.0;
+}
+
+Vector3 intersection(const Vector3& p0, double d0, const Vector3& p1, double d1)
+{
+    return p0 + (p1 - p0) * (d0 / (d0 - d1));
+}
+
+// Volume and moment of the part of the tetrahedron with negative distances
+void clipTetrahedron(const Vector3 p[4], const double d[4], double& out_volume, Vector3& out_moment)
+{
+    out_volume = 0.0;
+    out_moment.setZero();
+
+    int below[4], above[4];
+    int numBelow = 0, numAbove = 0;
+    for(int i = 0; i < 4; ++i) {
+        if(d[i] < 0.0) {
+            below[numBelow++] = i;
+        } else {
+            above[numAbove++] = i;
+        }
+    }
+
+    if(numBelow == 4) {
+        addTetrahedron(p[0], p[1], p[2], p[3], out_volume, out_moment);
+
+    } else if(numBelow == 1 || numBelow == 3) {
+        const bool isTipBelow = numBelow == 1;
+        const int tip = isTipBelow ? below[0] : above[0];
+        const int* others = isTipBelow ? above : below;
+        Vector3 q[3];
+        for(int i = 0; i < 3; ++i) {
+            q[i] = intersection(p[tip], d[tip], p[others[i]], d[others[i]]);
+        }
+        addTetrahedron(p[tip], q[0], q[1], q[2], out_volume, out_moment);
+        if(!isTipBelow) {
+            double fullVolume = 0.0;
+            Vector3 fullMoment = Vector3::Zero();
+            addTetrahedron(p[0], p[1], p[2], p[3], fullVolume, fullMoment);
+            out_volume = std::max(0.0, fullVolume - out_volume);
+            out_moment = fullMoment - out_moment;
+        }
+
+    } else if(numBelow == 2) {
+        // the submerged part is a wedge between the triangles cut at each submerged vertex
+        const int a = below[0], b = below[1], c = above[0], e = above[1];
+        const Vector3 ac = intersection(p[a], d[a], p[c], d[c]);
+        const Vector3 ae = intersection(p[a], d[a], p[e], d[e]);
+        const Vector3 bc = intersection(p[b], d[b], p[c], d[c]);
+        const Vector3 be = intersection(p[b], d[b], p[e], d[e]);
+        addTetrahedron(p[a], ac, ae, be, out_volume, out_moment);
+        addTetrahedron(p[a], ac, bc, be, out_volume, out_moment);
+        addTetrahedron(p[a], p[b], bc, be, out_volume, out_moment);
+    }
+}
+
+}
+
+
+ImmersionHull::ImmersionHull()
+{
+    clear();
+}
+
+
+void ImmersionHull::clear()
+{
+    origin.setZero();
+    tetrahedra.clear();
+    volume_ = 0.0;
+    radius_ = 0.0;
+    margin = 0.0;
+    isClassified = false;
+    boundaryTetrahedra.clear();
+    submergedVolume = 0.0;
+    submergedMoment.setZero();
+}
+
+
+void ImmersionHull::build(const vector<Vector3>& triangleVertices)
+{
+    clear();
+    const int numVertices = triangleVertices.size() / 3 * 3;
+    if(numVertices == 0) {
+        return;
+    }
+
+    for(int i = 0; i < numVertices; ++i) {
+        origin += triangleVertices[i];
+    }
+    origin /= numVertices;
+
+    tetrahedra.reserve(numVertices / 3);
+    for(int i = 0; i < numVertices; i += 3) {
+        Tetrahedron t;
+        t.a = triangleVertices[i];
+        t.b = triangleVertices[i + 1];
+        t.c = triangleVertices[i + 2];
+        t.volume = (t.a - origin).dot((t.b - origin).cross(t.c - origin)) / 6.0;
+        t.center = (origin + t.a + t.b + t.c) / 4.0;
+        volume_ += t.volume;
+        tetrahedra.push_back(t);
+        radius_ = std::max({ radius_, (t.a - origin).norm(), (t.b - origin).norm(), (t.c - origin).norm() });
+    }
+
+    // the triangles may be wound inward
+    if(volume_ < 0.0) {
+        for(auto& t : tetrahedra) {
+            t.volume = -t.volume;
+        }
+        volume_ = -volume_;
+    }
+    margin = MarginRatio * radius_;
+}
+
+
+Vector3 ImmersionHull::support(const Vector3& direction) const
+{
+    Vector3 p = origin;
+    double d = direction.dot(origin);
+    for(auto& t : tetrahedra) {
+        for(auto& v : { t.a, t.b, t.c }) {
+            const double dv = direction.dot(v);
+            if(dv > d) {
+                d = dv;
+                p = v;
+            }
+        }
+    }
+    return p;
+}
+
+
+void ImmersionHull::classify(const Vector3& up, double level)
+{
+    boundaryTetrahedra.clear();
+    submergedVolume = 0.0;
+    submergedMoment.setZero();
+
+    const double d0 = up.dot(origin) - level;
+    for(size_t i = 0; i < tetrahedra.size(); ++i) {
+        const Tetrahedron& t = tetrahedra[i];
+        const double da = up.dot(t.a) - level;
+        const double db = up.dot(t.b) - level;
+        const double dc = up.dot(t.c) - level;
+        const double dmin = std::min({ d0, da, db, dc });
+        const double dmax = std::max({ d0, da, db, dc });
+        if(dmax < -margin) {
+            submergedVolume += t.volume;
+            submergedMoment += t.volume * t.center;
+        } else if(dmin <= margin) {
+            boundaryTetrahedra.push_back(i);
+        }
+    }
+
+    classifiedUp = up;
+    classifiedLevel = level;
+    isClassified = true;
+}
+
+
+double ImmersionHull::calcSubmergedVolume(const Vector3& up, double level, Vector3& out_center)
+{
+    out_center = origin;
+    if(tetrahedra.empty()) {
+        return 0.0;
+    }
+
+    // Upper bound of the change of the signed distances of the vertices
+    // since the classification. The classes stay valid while it is below the margin.
+    bool isValid = false;
+    if(isClassified) {
+        const Vector3 dUp = up - classifiedUp;
+        const double change = fabs(dUp.dot(origin) - (level - classifiedLevel)) + dUp.norm() * radius_;
+        isValid = change < margin;
+    }
+    if(!isValid) {
+        classify(up, level);
+    }
+
+    double volume = submergedVolume;
+    Vector3 moment = submergedMoment;
+    Vector3 p[4];
+    double d[4];
+    p[0] = origin;
+    d[0] = up.dot(origin) - level;
+    for(auto& index : boundaryTetrahedra) {
+        const Tetrahedron& t = tetrahedra[index];
+        p[1] = t.a;
+        p[2] = t.b;
+        p[3] = t.c;
+        for(int i = 1; i < 4; ++i) {
+            d[i] = up.dot(p[i]) - level;
+        }
+        double clippedVolume;
+        Vector3 clippedMoment;
+        clipTetrahedron(p, d, clippedVolume, clippedMoment);
+        // the tetrahedra with a negative volume carve out the concave parts
+        if(t.volume < 0.0) {
+            clippedVolume = -clippedVolume;
+            clippedMoment = -clippedMoment;
+        }
+        volume += clippedVolume;
+        moment += clippedMoment;
+    }
+
+    if(volume <= 0.0) {
+        return 0.0;
+    }
+    out_center = moment / volume;
+    return std::min(volume, volume_);
+}
@@ -0,0 +1,74 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_IMMERSION_HULL_H
+#define CNOID_CFD_PLUGIN_IMMERSION_HULL_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Closed mesh of a link decomposed into the tetrahedra spanned by its
+   triangles and its centroid, used to compute the volume below a fluid
+   surface. The tetrahedra lying clearly above or below the surface are
+   classified once and reused while the surface moves less than a margin
+   relative to the link, so only the tetrahedra near the surface are clipped
+   in most steps.
+*/
+class CNOID_EXPORT ImmersionHull
+{
+public:
+    ImmersionHull();
+
+    void clear();
+    bool empty() const { return tetrahedra.empty(); }
+
+    // The vertices are given in the link-local frame, three for each triangle
+    void build(const std::vector<Vector3>& triangleVertices);
+
+    double volume() const { return volume_; }
+    const Vector3& center() const { return origin; }
+    double radius() const { return radius_; }
+    // The farthest vertex in the direction in the link-local frame
+    Vector3 support(const Vector3& direction) const;
+
+    /**
+       Computes the volume of the part below the plane up.dot(x) = level.
+       @param up unit normal of the surface in the link-local frame
+       @param level height of the surface along up in the link-local frame
+       @param out_center center of the submerged volume in the link-local frame
+       @return the submerged volume
+    */
+    double calcSubmergedVolume(const Vector3& up, double level, Vector3& out_center);
+
+private:
+    struct Tetrahedron {
+        Vector3 a, b, c;
+        double volume;
+        Vector3 center;
+    };
+
+    void classify(const Vector3& up, double level);
+
+    Vector3 origin;
+    std::vector<Tetrahedron> tetrahedra;
+    double volume_;
+    double radius_;
+    double margin;
+
+    // classification of the tetrahedra for the last surface
+    bool isClassified;
+    Vector3 classifiedUp;
+    double classifiedLevel;
+    std::vector<int> boundaryTetrahedra;
+    double submergedVolume;
+    Vector3 submergedMoment;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_IMMERSION_HULL_H
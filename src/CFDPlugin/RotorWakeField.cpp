@@ -0,0 +1,179 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "RotorWakeField.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// length of a free wake in rotor diameters
+const double WakeLengthRatio = 5.0;
+
+const double MinCellSize = 0.1;
+
+}
+
+
+RotorWakeField::RotorWakeField()
+{
+    cellSize = MinCellSize;
+}
+
+
+void RotorWakeField::clearObstacles()
+{
+    obstacles.clear();
+}
+
+
+void RotorWakeField::addObstacle(const BoundingBox& bbox)
+{
+    if(!bbox.empty()) {
+        obstacles.push_back(bbox);
+    }
+}
+
+
+void RotorWakeField::clear()
+{
+    wakes.clear();
+    cells.clear();
+}
+
+
+void RotorWakeField::addWake(int owner, const Vector3& position, const Vector3& direction,
+                             double radius, double inducedVelocity)
+{
+    if(radius <= 0.0 || inducedVelocity <= 0.0) {
+        return;
+    }
+    double length = WakeLengthRatio * 2.0 * radius;
+    double distance = obstacleDistance(position, direction);
+    if(distance >= 0.0) {
+        length = std::min(length, distance);
+    }
+    wakes.push_back({ owner, position, direction, radius, inducedVelocity, length });
+}
+
+
+int64_t RotorWakeField::cellKey(int x, int y, int z) const
+{
+    const uint64_t mask = (1 << 21) - 1;
+    return (int64_t)(((uint64_t)x & mask) << 42 | ((uint64_t)y & mask) << 21 | ((uint64_t)z & mask));
+}
+
+
+void RotorWakeField::build()
+{
+    cells.clear();
+    double maxRadius = 0.0;
+    for(auto& wake : wakes) {
+        maxRadius = std::max(maxRadius, wake.radius);
+    }
+    cellSize = std::max(MinCellSize, 2.0 * maxRadius);
+
+    for(size_t i = 0; i < wakes.size(); ++i) {
+        const Wake& wake = wakes[i];
+        const Vector3 end = wake.position + wake.direction * wake.length;
+        const Vector3 margin = Vector3::Constant(wake.radius);
+        const Vector3 lower = (wake.position.cwiseMin(end) - margin) / cellSize;
+        const Vector3 upper = (wake.position.cwiseMax(end) + margin) / cellSize;
+        for(int x = (int)floor(lower.x()); x <= (int)floor(upper.x()); ++x) {
+            for(int y = (int)floor(lower.y()); y <= (int)floor(upper.y()); ++y) {
+                for(int z = (int)floor(lower.z()); z <= (int)floor(upper.z()); ++z) {
+                    cells.emplace_back(cellKey(x, y, z), i);
+                }
+            }
+        }
+    }
+    std::sort(cells.begin(), cells.end());
+}
+
+
+Vector3 RotorWakeField::inducedVelocity(const Vector3& p, int excludedOwner) const
+{
+    Vector3 velocity = Vector3::Zero();
+    if(cells.empty()) {
+        return velocity;
+    }
+
+    const int64_t key = cellKey((int)floor(p.x() / cellSize), (int)floor(p.y() / cellSize), (int)floor(p.z() / cellSize));
+    auto it = std::lower_bound(cells.begin(), cells.end(), std::make_pair(key, INT_MIN));
+    for(; it != cells.end() && it->first == key; ++it) {
+        const Wake& wake = wakes[it->second];
+        if(wake.owner == excludedOwner) {
+            continue;
+        }
+        const Vector3 r = p - wake.position;
+        const double s = wake.direction.dot(r);
+        if(s < 0.0 || s > wake.length) {
+            continue;
+        }
+        // The flow accelerates to twice the induced velocity far from the disk
+        // and the wake contracts to keep the mass flow.
+        const double R = wake.radius;
+        const double ratio = 1.0 + s / sqrt(s * s + R * R);
+        const double radius = R / sqrt(ratio);
+        if((r - s * wake.direction).squaredNorm() <= radius * radius) {
+            velocity += wake.direction * (wake.inducedVelocity * ratio);
+        }
+    }
+    return velocity;
+}
+
+
+double RotorWakeField::obstacleDistance(const Vector3& origin, const Vector3& direction) const
+{
+    double distance = -1.0;
+    for(auto& bbox : obstacles) {
+        // a box enclosing the rotor, such as the one of a room, is not an obstacle below it
+        if((origin.array() >= bbox.min().array()).all() && (origin.array() <= bbox.max().array()).all()) {
+            continue;
+        }
+        double tmin = 0.0;
+        double tmax = HUGE_VAL;
+        bool isHit = true;
+        for(int i = 0; i < 3; ++i) {
+            if(fabs(direction[i]) < 1.0e-12) {
+                if(origin[i] < bbox.min()[i] || origin[i] > bbox.max()[i]) {
+                    isHit = false;
+                    break;
+                }
+            } else {
+                double t0 = (bbox.min()[i] - origin[i]) / direction[i];
+                double t1 = (bbox.max()[i] - origin[i]) / direction[i];
+                if(t0 > t1) {
+                    std::swap(t0, t1);
+                }
+                tmin = std::max(tmin, t0);
+                tmax = std::min(tmax, t1);
+                if(tmin > tmax) {
+                    isHit = false;
+                    break;
+                }
+            }
+        }
+        if(isHit && (distance < 0.0 || tmin < distance)) {
+            distance = tmin;
+        }
+    }
+    return distance;
+}
+
+
+double RotorWakeField::groundEffectRatio(double radius, double distance)
+{
+    if(distance < 0.0 || radius <= 0.0) {
+        return 1.0;
+    }
+    // the model diverges at a quarter of the radius
+    const double z = std::max(distance, 0.5 * radius);
+    const double a = radius / (4.0 * z);
+    return 1.0 / (1.0 - a * a);
+}
@@ -0,0 +1,76 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_ROTOR_WAKE_FIELD_H
+#define CNOID_CFD_PLUGIN_ROTOR_WAKE_FIELD_H
+
+#include <cnoid/BoundingBox>
+#include <cnoid/EigenTypes>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Downwash of the rotors modeled as momentum theory wake cylinders.
+   The wakes of a step are registered to a spatial hash of uniform cells so
+   that a query only visits the wakes passing near the point, and the cost
+   grows linearly with the number of rotors. The wakes are cut off by the
+   static obstacles, which also give the ground effect of the rotors.
+   The obstacles are world axis-aligned boxes, so a sloped or uneven terrain
+   is as high as its highest point, and a box enclosing the rotor is ignored.
+*/
+class CNOID_EXPORT RotorWakeField
+{
+public:
+    RotorWakeField();
+
+    void clearObstacles();
+    void addObstacle(const BoundingBox& bbox);
+
+    void clear();
+    /**
+       @param owner index of the body the rotor belongs to
+       @param position center of the rotor disk
+       @param direction unit direction of the wake flow
+       @param radius radius of the rotor disk
+       @param inducedVelocity induced velocity at the rotor disk
+    */
+    void addWake(int owner, const Vector3& position, const Vector3& direction,
+                 double radius, double inducedVelocity);
+    void build();
+    bool empty() const { return wakes.empty(); }
+
+    // Velocity induced by the wakes except the ones of the excluded owner
+    Vector3 inducedVelocity(const Vector3& p, int excludedOwner = -1) const;
+
+    // Distance to the nearest obstacle along the ray, or a negative value
+    double obstacleDistance(const Vector3& origin, const Vector3& direction) const;
+
+    // Cheeseman-Bennett ratio of the thrust in ground effect to the thrust out of it
+    static double groundEffectRatio(double radius, double distance);
+
+private:
+    struct Wake {
+        int owner;
+        Vector3 position;
+        Vector3 direction;
+        double radius;
+        double inducedVelocity;
+        double length;
+    };
+
+    int64_t cellKey(int x, int y, int z) const;
+
+    std::vector<BoundingBox> obstacles;
+    std::vector<Wake> wakes;
+    std::vector<std::pair<int64_t, int>> cells;
+    double cellSize;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_ROTOR_WAKE_FIELD_H
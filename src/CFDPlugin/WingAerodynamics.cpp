@@ -0,0 +1,195 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "WingAerodynamics.h"
+#include <cnoid/ColliderIndex>
+#include <cnoid/Link>
+#include <cnoid/MathUtil>
+#include <cnoid/MeshExtractor>
+#include <cnoid/ColliderSnapshot>
+#include <cnoid/SceneDrawables>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// lift slope per degree used when the wing has no coefficient table
+const double DefaultLiftSlope = 0.1;
+
+}
+
+
+WingAerodynamics::WingAerodynamics()
+{
+    clear();
+}
+
+
+void WingAerodynamics::clear()
+{
+    wings.clear();
+    areas.clear();
+    chords.clear();
+    aerodynamicCenters.clear();
+    densities.clear();
+    tableOffsets.clear();
+    tableSizes.clear();
+    aoas.clear();
+    cls.clear();
+    cds.clear();
+    hasDragTable.clear();
+}
+
+
+void WingAerodynamics::addWing(WingDevice* wing)
+{
+    Link* link = wing->link();
+    SgNode* shape = link->visualShape();
+    if(!shape) {
+        shape = link->collisionShape();
+    }
+
+    // The planform is the projection of the mesh onto the x-y plane of the link.
+    // A closed mesh covers it once with the triangles facing up and once with the ones
+    // facing down, and an open plate only with one of them, so the larger side is taken.
+    double projectedAreas[2] = { 0.0, 0.0 };
+    Vector3 moments[2] = { Vector3::Zero(), Vector3::Zero() };
+    Vector3 lower = Vector3::Constant(HUGE_VAL);
+    Vector3 upper = Vector3::Constant(-HUGE_VAL);
+    if(shape) {
+        MeshExtractor extractor;
+        extractor.extract(shape, [&](){
+            SgMesh* mesh = extractor.currentMesh();
+            const Affine3& T = extractor.currentTransform();
+            const SgVertexArray& vertices = *mesh->vertices();
+            const int numTriangles = mesh->numTriangles();
+            for(int i = 0; i < numTriangles; ++i) {
+                SgMesh::TriangleRef src = mesh->triangle(i);
+                Vector3 a = T * vertices[src[0]].cast<Affine3::Scalar>();
+                Vector3 b = T * vertices[src[1]].cast<Affine3::Scalar>();
+                Vector3 c = T * vertices[src[2]].cast<Affine3::Scalar>();
+                double s = 0.5 * (b - a).cross(c - a).z();
+                const int side = s >= 0.0 ? 0 : 1;
+                s = fabs(s);
+                projectedAreas[side] += s;
+                moments[side] += s * (a + b + c) / 3.0;
+                lower = lower.cwiseMin(a).cwiseMin(b).cwiseMin(c);
+                upper = upper.cwiseMax(a).cwiseMax(b).cwiseMax(c);
+            }
+        });
+    }
+
+    const int side = projectedAreas[0] >= projectedAreas[1] ? 0 : 1;
+    double area = projectedAreas[side];
+    double chord = upper.x() - lower.x();
+    Vector3 center;
+    if(area > 0.0 && chord > 0.0) {
+        center = moments[side] / area;
+        // the aerodynamic center lies at a quarter chord behind the leading edge
+        center.x() = upper.x() - 0.25 * chord;
+    } else {
+        area = wing->wingspan() * wing->chordLength();
+        chord = wing->chordLength();
+        center = link->centerOfMass();
+    }
+
+    wings.push_back(wing);
+    areas.push_back(area);
+    chords.push_back(chord);
+    aerodynamicCenters.push_back(center);
+    densities.push_back(0.0);
+
+    tableOffsets.push_back(aoas.size());
+    tableSizes.push_back(wing->aoaTable().size());
+    aoas.insert(aoas.end(), wing->aoaTable().begin(), wing->aoaTable().end());
+    cls.insert(cls.end(), wing->clTable().begin(), wing->clTable().end());
+    hasDragTable.push_back(!wing->cdTable().empty());
+    if(wing->cdTable().empty()) {
+        cds.resize(aoas.size(), 0.0);
+    } else {
+        cds.insert(cds.end(), wing->cdTable().begin(), wing->cdTable().end());
+    }
+}
+
+
+double WingAerodynamics::lookUp(int table, const vector<double>& values, double aoa) const
+{
+    const int offset = tableOffsets[table];
+    const int size = tableSizes[table];
+    const double* x = &aoas[offset];
+    const double* y = &values[offset];
+    if(aoa <= x[0]) {
+        return y[0];
+    } else if(aoa >= x[size - 1]) {
+        return y[size - 1];
+    }
+    const int i = std::upper_bound(x, x + size, aoa) - x;
+    const double t = (aoa - x[i - 1]) / (x[i] - x[i - 1]);
+    return y[i - 1] + t * (y[i] - y[i - 1]);
+}
+
+
+void WingAerodynamics::applyForces(const ColliderIndex& colliderIndex, bool isBlended)
+{
+    const int numWings = wings.size();
+    for(int i = 0; i < numWings; ++i) {
+        const Vector3& p = wings[i]->link()->T().translation();
+        if(isBlended) {
+            colliderIndex.queryBlendWeights(p, hitColliders, hitWeights);
+            double density = 0.0;
+            for(size_t k = 0; k < hitColliders.size(); ++k) {
+                density += hitWeights[k] * hitColliders[k]->density;
+            }
+            densities[i] = density;
+        } else {
+            colliderIndex.queryColliders(p, hitColliders);
+            densities[i] = hitColliders.empty() ? 0.0 : hitColliders.back()->density;
+        }
+    }
+
+    for(int i = 0; i < numWings; ++i) {
+        WingDevice* wing = wings[i];
+        const double density = densities[i];
+        if(!wing->on() || density <= 0.0) {
+            continue;
+        }
+
+        Link* link = wing->link();
+        const Matrix3& R = link->R();
+        Vector3 v = link->v();
+        double v_norm = v.dot(v);
+        double v2 = v_norm * v_norm;
+        Vector3 v_local = R.transpose() * v;
+        if(v_local.x() <= 0.0) {
+            continue;
+        }
+        double aoa = -atan2(v_local.z(), v_local.x()) * TO_DEGREE;
+
+        double cl;
+        double cd = 0.0;
+        if(tableSizes[i] > 0) {
+            cl = lookUp(i, cls, aoa);
+            if(hasDragTable[i]) {
+                cd = lookUp(i, cds, aoa);
+            }
+        } else {
+            cl = wing->cl() + DefaultLiftSlope * aoa;
+        }
+
+        double q = 0.5 * density * v2 * areas[i];
+        Vector3 f = Vector3::Zero();
+        Vector3 n = v.cross(R.col(2)).cross(v);
+        if(n.norm() > 0.0) {
+            f += q * cl * n.normalized();
+        }
+        f -= q * cd * v.normalized();
+
+        const Vector3 p = link->T() * aerodynamicCenters[i];
+        link->f_ext() += f;
+        link->tau_ext() += p.cross(f);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_WING_AERODYNAMICS_H
+#define CNOID_CFD_PLUGIN_WING_AERODYNAMICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "WingDevice.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ColliderIndex;
+struct ColliderSnapshot;
+
+/**
+   Lift and drag of the wing devices evaluated together in one pass.
+   The planform area, the chord and the aerodynamic center of each wing are
+   computed from the mesh of its link when the wing is added, and the
+   coefficient tables are flattened into shared arrays, so a step only reads
+   the link states and the fluid densities.
+*/
+class CNOID_EXPORT WingAerodynamics
+{
+public:
+    WingAerodynamics();
+
+    void clear();
+    void addWing(WingDevice* wing);
+    int numWings() const { return wings.size(); }
+
+    double planformArea(int index) const { return areas[index]; }
+    double chordLength(int index) const { return chords[index]; }
+
+    /**
+       Adds the lift and drag of the wings in the fluid colliders to their links.
+       @param isBlended whether the density is blended over the overlapping colliders
+       instead of taken from the last one
+    */
+    void applyForces(const ColliderIndex& colliderIndex, bool isBlended = false);
+
+private:
+    double lookUp(int table, const std::vector<double>& values, double aoa) const;
+
+    std::vector<WingDevicePtr> wings;
+    std::vector<double> areas;
+    std::vector<double> chords;
+    std::vector<Vector3> aerodynamicCenters;
+    std::vector<double> densities;
+
+    // the coefficient tables of all wings stored one after another
+    std::vector<int> tableOffsets;
+    std::vector<int> tableSizes;
+    std::vector<double> aoas;
+    std::vector<double> cls;
+    std::vector<double> cds;
+    std::vector<bool> hasDragTable;
+
+    std::vector<const ColliderSnapshot*> hitColliders;
+    std::vector<double> hitWeights;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_WING_AERODYNAMICS_H
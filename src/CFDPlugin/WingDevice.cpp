@@ -99,7 +99,7 @@ WingDevice::WingDevice(const WingDevice& org, bool copyStateOnly)
     if(!copyStateOnly) {
         spec.reset(new Spec);
         if(org.spec) {
-
+            *spec = *org.spec;
         } else {
 
         }
@@ -188,6 +188,27 @@ double* WingDevice::writeState(double* out_buf) const
 }
 
 
+void WingDevice::setCoefficientTable(const std::vector<double>& aoa, const std::vector<double>& cl, const std::vector<double>& cd)
+{
+    spec->aoaTable.clear();
+    spec->clTable.clear();
+    spec->cdTable.clear();
+
+    // the angles must increase monotonically to be looked up
+    if(aoa.size() != cl.size() || (!cd.empty() && aoa.size() != cd.size())) {
+        return;
+    }
+    for(size_t i = 1; i < aoa.size(); ++i) {
+        if(aoa[i] <= aoa[i - 1]) {
+            return;
+        }
+    }
+    spec->aoaTable = aoa;
+    spec->clTable = cl;
+    spec->cdTable = cd;
+}
+
+
 bool WingDevice::readSpecifications(const Mapping* info)
 {
     info->read("on", on_);
@@ -195,6 +216,19 @@ bool WingDevice::readSpecifications(const Mapping* info)
     info->read("wingspan", wingspan_);
     info->read("chord_length", chordLength_);
     info->read("symbol", symbol_);
+
+    std::vector<double> tables[3];
+    const char* keys[] = { "aoa_table", "cl_table", "cd_table" };
+    for(int i = 0; i < 3; ++i) {
+        auto& list = *info->findListing(keys[i]);
+        if(list.isValid()) {
+            for(int j = 0; j < list.size(); ++j) {
+                tables[i].push_back(list[j].toDouble());
+            }
+        }
+    }
+    setCoefficientTable(tables[0], tables[1], tables[2]);
+
     return true;
 }
 
@@ -206,6 +240,17 @@ bool WingDevice::writeSpecifications(Mapping* info) const
     info->write("wingspan", wingspan_);
     info->write("chord_length", chordLength_);
     info->write("symbol", symbol_);
+
+    const std::vector<double>* tables[] = { &spec->aoaTable, &spec->clTable, &spec->cdTable };
+    const char* keys[] = { "aoa_table", "cl_table", "cd_table" };
+    for(int i = 0; i < 3; ++i) {
+        if(!tables[i]->empty()) {
+            Listing* list = info->createFlowStyleListing(keys[i]);
+            for(auto& value : *tables[i]) {
+                list->append(value);
+            }
+        }
+    }
     return true;
 }
 
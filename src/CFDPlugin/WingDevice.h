@@ -7,6 +7,7 @@
 
 #include <cnoid/Device>
 #include <memory>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -41,6 +42,13 @@ public:
     void setSymbol(bool symbol) { symbol_ = symbol; }
     bool symbol() const { return symbol_; }
 
+    // Lift and drag coefficients tabulated for the angles of attack in degrees.
+    // The drag table replaces the panel drag of the link while the wing lift is enabled.
+    const std::vector<double>& aoaTable() const { return spec->aoaTable; }
+    const std::vector<double>& clTable() const { return spec->clTable; }
+    const std::vector<double>& cdTable() const { return spec->cdTable; }
+    void setCoefficientTable(const std::vector<double>& aoa, const std::vector<double>& cl, const std::vector<double>& cd);
+
     bool readSpecifications(const Mapping* info);
     bool writeSpecifications(Mapping* info) const;
 
@@ -55,7 +63,9 @@ private:
     bool symbol_;
 
     struct Spec {
-
+        std::vector<double> aoaTable;
+        std::vector<double> clTable;
+        std::vector<double> cdTable;
     };
     std::unique_ptr<Spec> spec;
 
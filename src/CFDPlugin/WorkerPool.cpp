@@ -0,0 +1,181 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class WorkerPool::Impl
+{
+public:
+    Impl();
+    ~Impl();
+
+    void start(int numThreads);
+    void stop();
+    void work(unsigned int lastGeneration);
+    void runTasks();
+
+    vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable finishCondition;
+    const std::function<void(int)>* func;
+    std::atomic<int> nextIndex;
+    int numIndices;
+    int numActiveWorkers;
+    unsigned int generation;
+    bool isExiting;
+};
+
+}
+
+
+WorkerPool::WorkerPool()
+{
+    impl = new Impl;
+}
+
+
+WorkerPool::Impl::Impl()
+    : func(nullptr),
+      nextIndex(0),
+      numIndices(0),
+      numActiveWorkers(0),
+      generation(0),
+      isExiting(false)
+{
+
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    delete impl;
+}
+
+
+WorkerPool::Impl::~Impl()
+{
+    stop();
+}
+
+
+void WorkerPool::setNumThreads(int numThreads)
+{
+    if(numThreads <= 0) {
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    if(numThreads != this->numThreads()) {
+        impl->stop();
+        impl->start(numThreads);
+    }
+}
+
+
+int WorkerPool::numThreads() const
+{
+    // the calling thread is counted as one of the workers
+    return impl->threads.size() + 1;
+}
+
+
+void WorkerPool::Impl::start(int numThreads)
+{
+    // the workers of a restarted pool must not take the last round for a new one
+    unsigned int currentGeneration;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isExiting = false;
+        currentGeneration = generation;
+    }
+    for(int i = 1; i < numThreads; ++i) {
+        threads.emplace_back([this, currentGeneration](){ work(currentGeneration); });
+    }
+}
+
+
+void WorkerPool::Impl::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isExiting = true;
+    }
+    startCondition.notify_all();
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+
+void WorkerPool::Impl::work(unsigned int lastGeneration)
+{
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&](){ return isExiting || generation != lastGeneration; });
+            if(isExiting) {
+                break;
+            }
+            lastGeneration = generation;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --numActiveWorkers;
+        }
+        finishCondition.notify_one();
+    }
+}
+
+
+void WorkerPool::Impl::runTasks()
+{
+    int index;
+    while((index = nextIndex.fetch_add(1)) < numIndices) {
+        (*func)(index);
+    }
+}
+
+
+void WorkerPool::parallelFor(int n, const std::function<void(int index)>& func)
+{
+    if(n <= 0) {
+        return;
+    }
+    if(impl->threads.empty() || n == 1) {
+        for(int i = 0; i < n; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->func = &func;
+        impl->numIndices = n;
+        impl->nextIndex = 0;
+        impl->numActiveWorkers = impl->threads.size();
+        ++impl->generation;
+    }
+    impl->startCondition.notify_all();
+
+    impl->runTasks();
+
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    impl->finishCondition.wait(lock, [&](){ return impl->numActiveWorkers == 0; });
+    impl->func = nullptr;
+}
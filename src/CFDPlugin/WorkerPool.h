@@ -0,0 +1,38 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_CFD_PLUGIN_WORKER_POOL_H
+#define CNOID_CFD_PLUGIN_WORKER_POOL_H
+
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   A fixed set of worker threads running index-parallel loops.
+   The calling thread takes part in the loop and parallelFor() returns
+   after all the indices have been processed.
+*/
+class CNOID_EXPORT WorkerPool
+{
+public:
+    WorkerPool();
+    WorkerPool(const WorkerPool& org) = delete;
+    ~WorkerPool();
+
+    // 0 selects the number of hardware threads
+    void setNumThreads(int numThreads);
+    int numThreads() const;
+
+    void parallelFor(int n, const std::function<void(int index)>& func);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif // CNOID_CFD_PLUGIN_WORKER_POOL_H
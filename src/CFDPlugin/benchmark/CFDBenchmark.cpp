@@ -0,0 +1,390 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include <cnoid/ColliderIndex>
+#include <cnoid/EigenUtil>
+#include <cnoid/Link>
+#include <cnoid/MathUtil>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "../FluidForceEvaluator.h"
+#include "../Rotor.h"
+#include "../RotorWakeField.h"
+#include "../WorkerPool.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+std::atomic<long> numAllocations(0);
+
+}
+
+void* operator new(size_t size)
+{
+    ++numAllocations;
+    if(void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+
+namespace {
+
+enum LayoutId { AOS, SOA, EXPOSURE };
+
+struct Options
+{
+    int numBodies = 100;
+    int numTriangles = 1000;
+    int numColliders = 10;
+    int numRotors = 4;
+    int numSteps = 1000;
+    int numThreads = 1;
+    int exposureResolution = 16;
+    int layout = SOA;
+    bool isBoundaryBlendingEnabled = false;
+    bool isDownwashEnabled = false;
+    bool usePartialBuoyancy = false;
+};
+
+struct WakeSource
+{
+    int owner;
+    Vector3 position;
+    Vector3 direction;
+    double radius;
+    double inducedVelocity;
+};
+
+struct BenchBody
+{
+    LinkPtr link;
+    FluidLink fluidLink;
+    vector<RotorPtr> rotors;
+    vector<const ColliderSnapshot*> hitColliders;
+    vector<double> hitWeights;
+    Vector3 phase;
+};
+
+void printUsage()
+{
+    printf("Usage: cfd-benchmark [--bodies N] [--triangles M] [--colliders K] [--rotors R]\n"
+           "                     [--steps S] [--threads T] [--layout aos|soa|exposure]\n"
+           "                     [--exposure-resolution E] [--blending] [--downwash]\n"
+           "                     [--partial-buoyancy]\n");
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for(int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        auto next = [&](){ return (i + 1 < argc) ? argv[++i] : nullptr; };
+        if(arg == "--blending") {
+            options.isBoundaryBlendingEnabled = true;
+            continue;
+        } else if(arg == "--downwash") {
+            options.isDownwashEnabled = true;
+            continue;
+        } else if(arg == "--partial-buoyancy") {
+            options.usePartialBuoyancy = true;
+            continue;
+        }
+        const char* value = next();
+        if(!value) {
+            return false;
+        }
+        if(arg == "--bodies") {
+            options.numBodies = atoi(value);
+        } else if(arg == "--triangles") {
+            options.numTriangles = atoi(value);
+        } else if(arg == "--colliders") {
+            options.numColliders = atoi(value);
+        } else if(arg == "--rotors") {
+            options.numRotors = atoi(value);
+        } else if(arg == "--steps") {
+            options.numSteps = atoi(value);
+        } else if(arg == "--threads") {
+            options.numThreads = atoi(value);
+        } else if(arg == "--exposure-resolution") {
+            options.exposureResolution = atoi(value);
+        } else if(arg == "--layout") {
+            if(!strcmp(value, "aos")) {
+                options.layout = AOS;
+            } else if(!strcmp(value, "soa")) {
+                options.layout = SOA;
+            } else if(!strcmp(value, "exposure")) {
+                options.layout = EXPOSURE;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Triangulated ellipsoid with about numTriangles triangles
+void createHull(int numTriangles, const Vector3& radii, vector<Vector3>& out_triangleVertices)
+{
+    const int numSlices = std::max(3, (int)sqrt(numTriangles / 2.0));
+    const int numStacks = std::max(2, numTriangles / (2 * numSlices));
+    auto vertex = [&](int i, int j){
+        double theta = PI * i / numStacks;
+        double phi = 2.0 * PI * j / numSlices;
+        return Vector3(radii.x() * sin(theta) * cos(phi),
+                       radii.y() * sin(theta) * sin(phi),
+                       radii.z() * cos(theta));
+    };
+    out_triangleVertices.clear();
+    for(int i = 0; i < numStacks; ++i) {
+        for(int j = 0; j < numSlices; ++j) {
+            Vector3 a = vertex(i, j);
+            Vector3 b = vertex(i + 1, j);
+            Vector3 c = vertex(i + 1, j + 1);
+            Vector3 d = vertex(i, j + 1);
+            out_triangleVertices.insert(out_triangleVertices.end(), { a, b, c, a, c, d });
+        }
+    }
+}
+
+void createBodies(const Options& options, vector<BenchBody>& bodies, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    vector<Vector3> triangleVertices;
+    bodies.resize(options.numBodies);
+    for(auto& body : bodies) {
+        body.link = new Link;
+        Link* link = body.link;
+        link->setMass(2.0);
+        link->setCenterOfMass(Vector3::Zero());
+
+        // the parameters a body file gives in the info of the link
+        FluidLink& fluidLink = body.fluidLink;
+        fluidLink.link = link;
+        fluidLink.density = 500.0;
+        fluidLink.cdw = 1.0;
+        fluidLink.cda = 1.0;
+        fluidLink.cv = 0.1;
+        fluidLink.cw = 0.1;
+        fluidLink.usePackedPanels = options.layout == SOA;
+
+        Vector3 radii(0.5 + 0.2 * uniform(random), 0.3 + 0.1 * uniform(random), 0.2 + 0.05 * uniform(random));
+        createHull(options.numTriangles, radii, triangleVertices);
+        for(size_t i = 0; i + 2 < triangleVertices.size(); i += 3) {
+            const Vector3& a = triangleVertices[i];
+            const Vector3& b = triangleVertices[i + 1];
+            const Vector3& c = triangleVertices[i + 2];
+            Vector3 sn = 0.5 * (b - a).cross(c - a);
+            Vector3 g = (a + b + c) / 3.0;
+            if(fluidLink.usePackedPanels) {
+                fluidLink.panels.addPanel(sn, g);
+            } else {
+                fluidLink.sn.push_back(sn);
+                fluidLink.g.push_back(g);
+            }
+        }
+        if(options.layout == EXPOSURE) {
+            fluidLink.exposure.build(triangleVertices, options.exposureResolution);
+        }
+        if(options.usePartialBuoyancy) {
+            fluidLink.hull.build(triangleVertices);
+        }
+
+        body.phase << uniform(random), uniform(random), uniform(random);
+        for(int i = 0; i < options.numRotors; ++i) {
+            double angle = 2.0 * PI * i / std::max(1, options.numRotors);
+            RotorPtr rotor = new Rotor;
+            rotor->setLink(link);
+            rotor->setLocalTranslation(Vector3(0.3 * cos(angle), 0.3 * sin(angle), 0.1));
+            rotor->setKv(1000.0);
+            rotor->setDiameter(8.0);
+            rotor->setPitch(4.5);
+            rotor->voltage() = 11.1;
+            rotor->setReverse(i % 2);
+            body.rotors.push_back(rotor);
+        }
+    }
+}
+
+vector<ColliderSnapshotPtr> createColliders(const Options& options, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    vector<ColliderSnapshotPtr> colliders;
+    for(int i = 0; i < options.numColliders; ++i) {
+        auto collider = std::make_shared<ColliderSnapshot>();
+        collider->sceneType = i % 3;
+        collider->size << 10.0, 10.0, 10.0;
+        collider->radius = 5.0;
+        collider->height = 10.0;
+        collider->position.translation() << 20.0 * uniform(random), 20.0 * uniform(random), 5.0 * uniform(random);
+        collider->position.linear() = rotFromRpy(0.0, 0.0, PI * uniform(random));
+        collider->priority = i % 2;
+        collider->boundaryWidth = 1.0;
+        collider->density = i % 2 ? 1000.0 : 1.2;
+        collider->viscosity = 1.0e-3;
+        collider->steadyFlow << 0.1, 0.0, 0.0;
+        collider->compileShape();
+        colliders.push_back(collider);
+    }
+    return colliders;
+}
+
+void moveBodies(vector<BenchBody>& bodies, double time)
+{
+    for(auto& body : bodies) {
+        Link* link = body.link;
+        const Vector3& a = body.phase;
+        link->T().translation() << 15.0 * sin(time + 3.0 * a.x()), 15.0 * cos(0.7 * time + 3.0 * a.y()), 2.0 * a.z();
+        link->T().linear() = rotFromRpy(0.1 * time * a.x(), 0.2 * time * a.y(), time * a.z());
+        link->v() << 15.0 * cos(time + 3.0 * a.x()), -10.5 * sin(0.7 * time + 3.0 * a.y()), 0.1;
+        link->w() << 0.1 * a.x(), 0.2 * a.y(), a.z();
+    }
+}
+
+// Same as the rotor part of CFDSimulatorItemImpl::onPreDynamics without the batteries
+void applyRotorForces(const FluidForceEvaluator& evaluator, const ColliderIndex& index, bool isDownwashEnabled,
+                      BenchBody& body, int bodyIndex, vector<WakeSource>& wakeSources)
+{
+    Link* link = body.link;
+    for(auto& rotor : body.rotors) {
+        index.queryColliders(link->T().translation(), body.hitColliders);
+        const ColliderSnapshot* item = body.hitColliders.empty() ? nullptr : body.hitColliders.back();
+        if(!item || item->density >= 10.0) {
+            continue;
+        }
+        const double density = item->density;
+        double staticForce = evaluator.calcRotorThrust(rotor, rotor->voltage());
+
+        Matrix3 R = link->R() * rotor->R_local();
+        Vector3 direction = rotor->direction();
+        const Vector3 p = link->T() * rotor->p_local();
+        if(isDownwashEnabled && staticForce > 0.0 && density > 0.0) {
+            const Vector3 axis = (R * direction).normalized();
+            const double radius = rotor->diameter() * 0.0254 / 2.0;
+            const double area = PI * radius * radius;
+            if(area > 0.0) {
+                staticForce = evaluator.calcRotorWake(rotor, bodyIndex, p, axis, density, staticForce);
+                if(rotor->on() && staticForce > 0.0) {
+                    wakeSources.push_back({ bodyIndex, p, -axis, radius, sqrt(staticForce / (2.0 * density * area)) });
+                }
+            }
+        }
+        const Vector3 f = R * (direction * (rotor->force() + rotor->forceOffset() + staticForce));
+        Vector3 tau_ext = R * (direction * (rotor->torque() + rotor->torqueOffset()));
+        if(rotor->on()) {
+            link->f_ext() += f;
+            link->tau_ext() += p.cross(f) + tau_ext;
+        }
+    }
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if(!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::mt19937 random(1);
+    vector<BenchBody> bodies;
+    createBodies(options, bodies, random);
+    ColliderIndex index;
+    index.setSnapshots(createColliders(options, random));
+
+    RotorWakeField wakeField;
+    vector<WakeSource> wakeSources;
+    wakeSources.reserve(bodies.size() * options.numRotors);
+
+    FluidForceEvaluator evaluator;
+    evaluator.setColliderIndex(&index);
+    evaluator.setWakeField(&wakeField);
+    evaluator.setBoundaryBlendingEnabled(options.isBoundaryBlendingEnabled);
+
+    WorkerPool workerPool;
+    workerPool.setNumThreads(options.numThreads);
+
+    long numPanels = 0;
+    for(auto& body : bodies) {
+        numPanels += body.fluidLink.usePackedPanels ? body.fluidLink.panels.numPanels() : body.fluidLink.sn.size();
+    }
+
+    const double timeStep = 0.001;
+    double totalTime = 0.0;
+    long allocationsBefore = numAllocations;
+
+    for(int step = 0; step < options.numSteps; ++step) {
+        moveBodies(bodies, step * timeStep);
+
+        auto start = std::chrono::steady_clock::now();
+
+        index.update();
+        workerPool.parallelFor(bodies.size(), [&](int i){
+            BenchBody& body = bodies[i];
+            evaluator.calcLinkForces(body.fluidLink, i, body.hitColliders, body.hitWeights);
+        });
+        for(size_t i = 0; i < bodies.size(); ++i) {
+            BenchBody& body = bodies[i];
+            body.link->f_ext() = body.fluidLink.f;
+            body.link->tau_ext() = body.fluidLink.tau;
+            applyRotorForces(evaluator, index, options.isDownwashEnabled, body, i, wakeSources);
+        }
+        if(options.isDownwashEnabled) {
+            wakeField.clear();
+            for(auto& source : wakeSources) {
+                wakeField.addWake(source.owner, source.position, source.direction, source.radius, source.inducedVelocity);
+            }
+            wakeField.build();
+            wakeSources.clear();
+        }
+
+        totalTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    long allocations = numAllocations - allocationsBefore;
+    const char* layouts[] = { "aos", "soa", "exposure" };
+    double nsPerStep = totalTime / options.numSteps * 1.0e9;
+    double panelsPerSecond = numPanels * options.numSteps / totalTime;
+
+    printf("bodies: %d, triangles: %d, colliders: %d, rotors: %d, steps: %d\n",
+           options.numBodies, options.numTriangles, options.numColliders, options.numRotors, options.numSteps);
+    printf("layout: %s, blending: %s, downwash: %s, partial buoyancy: %s, threads: %d\n",
+           layouts[options.layout], options.isBoundaryBlendingEnabled ? "on" : "off",
+           options.isDownwashEnabled ? "on" : "off", options.usePartialBuoyancy ? "on" : "off",
+           workerPool.numThreads());
+    printf("time: %.1f ns/step\n", nsPerStep);
+    if(options.layout != EXPOSURE) {
+        printf("panels: %.3g panels/s\n", panelsPerSecond);
+    }
+    printf("allocations: %ld (%.2f per step)\n", allocations, (double)allocations / options.numSteps);
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include <cnoid/SimulatorItem>
 #include <cnoid/WorldItem>
 #include <cnoid/MultiColliderItem>
+#include <cnoid/ColliderIndex>
 #include "NetEm.h"
 #include "gettext.h"
 
@@ -71,6 +72,8 @@ public:
     Selection interface;
     Selection ifbDevice;
     ItemList<MultiColliderItem> colliders;
+    ColliderIndex colliderIndex;
+    vector<const ColliderSnapshot*> hitColliders;
 
     bool initializeSimulation(SimulatorItem* simulatorItem);
     void onPreDynamics();
@@ -158,6 +161,8 @@ bool NetworkEmulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorIte
         }
     }
 
+    colliderIndex.setColliders(colliders);
+
     if(simBodies.size()) {
         netem->start(interface.which(), ifbDevice.which());
         simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
@@ -174,33 +179,34 @@ void NetworkEmulatorItem::finalizeSimulation()
 
 void NetworkEmulatorItem::Impl::onPreDynamics()
 {
+    colliderIndex.update();
+
     for(auto& body : bodies) {
         if(!body->isStaticModel()) {
             Link* link = body->rootLink();
-            for(auto& collider : colliders) {
-                if(collision(collider, link->T().translation())) {
-                    const int delays[] = { (int)collider->inboundDelay(), (int)collider->outboundDelay() };
-                    const int rates[] = { (int)collider->inboundRate(), (int)collider->outboundRate() };
-                    const double losses[] = { collider->inboundLoss(), collider->outboundLoss() };
-                    for(int i = 0; i < 2; ++i) {
-                        if(delays[i] >= 0) {
-                            netem->setDelay(i, delays[i]);
-                        }
-                        if(rates[i] >= 0) {
-                            netem->setRate(i, rates[i]);
-                        }
-                        if(losses[i] >= 0.0) {
-                            netem->setLoss(i, losses[i]);
-                        }
+            colliderIndex.queryColliders(link->T().translation(), hitColliders);
+            for(auto& collider : hitColliders) {
+                const int delays[] = { (int)collider->inboundDelay, (int)collider->outboundDelay };
+                const int rates[] = { (int)collider->inboundRate, (int)collider->outboundRate };
+                const double losses[] = { collider->inboundLoss, collider->outboundLoss };
+                for(int i = 0; i < 2; ++i) {
+                    if(delays[i] >= 0) {
+                        netem->setDelay(i, delays[i]);
                     }
-                    if(checkIP(collider->source())) {
-                        netem->setSourceIP(collider->source());
+                    if(rates[i] >= 0) {
+                        netem->setRate(i, rates[i]);
                     }
-                    if(checkIP(collider->destination())) {
-                        netem->setSourceIP(collider->destination());
+                    if(losses[i] >= 0.0) {
+                        netem->setLoss(i, losses[i]);
                     }
-                    callLater([&](){ netem->update(); });
                 }
+                if(checkIP(collider->source)) {
+                    netem->setSourceIP(collider->source);
+                }
+                if(checkIP(collider->destination)) {
+                    netem->setSourceIP(collider->destination);
+                }
+                callLater([&](){ netem->update(); });
             }
         }
     }
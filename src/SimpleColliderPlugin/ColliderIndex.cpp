@@ -0,0 +1,439 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "ColliderIndex.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int MaxLeafSize = 4;
+const int MaxHits = 64;
+
+struct Node
+{
+    Vector3 min;
+    Vector3 max;
+    int left;
+    int right;
+    int begin;
+    int end;
+};
+
+inline bool contains(const Vector3& min, const Vector3& max, const Vector3& p)
+{
+    return (min[0] <= p[0]) && (p[0] <= max[0])
+        && (min[1] <= p[1]) && (p[1] <= max[1])
+        && (min[2] <= p[2]) && (p[2] <= max[2]);
+}
+
+}
+
+namespace cnoid {
+
+class ColliderIndex::Impl
+{
+public:
+    ColliderIndex* self;
+
+    Impl(ColliderIndex* self);
+
+    ItemList<MultiColliderItem> colliders;
+    vector<ColliderSnapshotPtr> snapshots;
+    vector<Vector3> boxMin;
+    vector<Vector3> boxMax;
+    vector<int> order;
+    vector<Node> nodes;
+    vector<int> sweepOrder;
+
+    bool updateSnapshots();
+    void build();
+    int buildNode(int begin, int end);
+    int query(const Vector3& point, int* hits, vector<int>& extraHits) const;
+};
+
+}
+
+
+ColliderIndex::ColliderIndex()
+{
+    impl = new Impl(this);
+}
+
+
+ColliderIndex::Impl::Impl(ColliderIndex* self)
+    : self(self)
+{
+    colliders.clear();
+    snapshots.clear();
+    nodes.clear();
+}
+
+
+ColliderIndex::~ColliderIndex()
+{
+    delete impl;
+}
+
+
+void ColliderIndex::clear()
+{
+    impl->colliders.clear();
+    impl->snapshots.clear();
+    impl->boxMin.clear();
+    impl->boxMax.clear();
+    impl->order.clear();
+    impl->nodes.clear();
+    impl->sweepOrder.clear();
+}
+
+
+void ColliderIndex::setColliders(const ItemList<MultiColliderItem>& colliders)
+{
+    clear();
+    impl->colliders = colliders;
+    for(auto& collider : colliders) {
+        collider->publishSnapshot();
+        impl->snapshots.push_back(collider->snapshot());
+    }
+    impl->build();
+}
+
+
+void ColliderIndex::setSnapshots(const vector<ColliderSnapshotPtr>& snapshots)
+{
+    clear();
+    impl->snapshots = snapshots;
+    impl->build();
+}
+
+
+const ItemList<MultiColliderItem>& ColliderIndex::colliders() const
+{
+    return impl->colliders;
+}
+
+
+bool ColliderIndex::update()
+{
+    if(impl->updateSnapshots()) {
+        impl->build();
+        return true;
+    }
+    return false;
+}
+
+
+bool ColliderIndex::Impl::updateSnapshots()
+{
+    // the hierarchy only depends on the geometry, so the other changes just replace the snapshots
+    bool isMoved = false;
+    for(size_t i = 0; i < colliders.size(); ++i) {
+        ColliderSnapshotPtr snapshot = colliders[i]->snapshot();
+        if(snapshot->version != snapshots[i]->version) {
+            if(!snapshot->hasSameGeometry(*snapshots[i])) {
+                isMoved = true;
+            }
+            snapshots[i] = snapshot;
+        }
+    }
+    return isMoved;
+}
+
+
+void ColliderIndex::Impl::build()
+{
+    const int n = snapshots.size();
+    boxMin.resize(n);
+    boxMax.resize(n);
+    order.resize(n);
+    sweepOrder.resize(n);
+    nodes.clear();
+
+    for(int i = 0; i < n; ++i) {
+        const BoundingBox& bb = snapshots[i]->boundingBox;
+        boxMin[i] = bb.min();
+        boxMax[i] = bb.max();
+        order[i] = i;
+        sweepOrder[i] = i;
+    }
+    std::sort(sweepOrder.begin(), sweepOrder.end(),
+              [&](int a, int b){ return boxMin[a][0] < boxMin[b][0]; });
+
+    if(n > 0) {
+        nodes.reserve(2 * n);
+        buildNode(0, n);
+    }
+}
+
+
+int ColliderIndex::Impl::buildNode(int begin, int end)
+{
+    int index = nodes.size();
+    nodes.push_back(Node());
+
+    Vector3 min = boxMin[order[begin]];
+    Vector3 max = boxMax[order[begin]];
+    for(int i = begin + 1; i < end; ++i) {
+        min = min.cwiseMin(boxMin[order[i]]);
+        max = max.cwiseMax(boxMax[order[i]]);
+    }
+
+    int left = -1;
+    int right = -1;
+    if(end - begin > MaxLeafSize) {
+        // split at the median of the box centers along the longest axis
+        int axis;
+        (max - min).maxCoeff(&axis);
+        int mid = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b){
+                             return boxMin[a][axis] + boxMax[a][axis] < boxMin[b][axis] + boxMax[b][axis];
+                         });
+        left = buildNode(begin, mid);
+        right = buildNode(mid, end);
+    }
+
+    Node& node = nodes[index];
+    node.min = min;
+    node.max = max;
+    node.left = left;
+    node.right = right;
+    node.begin = begin;
+    node.end = end;
+    return index;
+}
+
+
+int ColliderIndex::Impl::query(const Vector3& point, int* hits, vector<int>& extraHits) const
+{
+    int numHits = 0;
+    extraHits.clear();
+    if(nodes.empty()) {
+        return 0;
+    }
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if(!contains(node.min, node.max, point)) {
+            continue;
+        }
+        if(node.left < 0) {
+            for(int i = node.begin; i < node.end; ++i) {
+                int id = order[i];
+                if(contains(boxMin[id], boxMax[id], point)
+                   && snapshots[id]->shape.contains(point)) {
+                    if(numHits < MaxHits) {
+                        hits[numHits++] = id;
+                    } else {
+                        extraHits.push_back(id);
+                    }
+                }
+            }
+        } else {
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+
+    // keep the order of the collider list so that callers
+    // resolve overlapping colliders exactly as before
+    if(extraHits.empty()) {
+        std::sort(hits, hits + numHits);
+        return numHits;
+    }
+    extraHits.insert(extraHits.end(), hits, hits + numHits);
+    std::sort(extraHits.begin(), extraHits.end());
+    return -1;
+}
+
+
+void ColliderIndex::queryColliders(const Vector3& point, vector<MultiColliderItem*>& out_colliders) const
+{
+    out_colliders.clear();
+    int hits[MaxHits];
+    vector<int> extraHits;
+    int numHits = impl->query(point, hits, extraHits);
+    if(numHits >= 0) {
+        for(int i = 0; i < numHits; ++i) {
+            out_colliders.push_back(impl->colliders[hits[i]]);
+        }
+    } else {
+        for(auto& id : extraHits) {
+            out_colliders.push_back(impl->colliders[id]);
+        }
+    }
+}
+
+
+void ColliderIndex::queryColliders(const Vector3& point, vector<const ColliderSnapshot*>& out_snapshots) const
+{
+    out_snapshots.clear();
+    int hits[MaxHits];
+    vector<int> extraHits;
+    int numHits = impl->query(point, hits, extraHits);
+    if(numHits >= 0) {
+        for(int i = 0; i < numHits; ++i) {
+            out_snapshots.push_back(impl->snapshots[hits[i]].get());
+        }
+    } else {
+        for(auto& id : extraHits) {
+            out_snapshots.push_back(impl->snapshots[id].get());
+        }
+    }
+}
+
+
+vector<MultiColliderItem*> ColliderIndex::queryColliders(const Vector3& point) const
+{
+    vector<MultiColliderItem*> colliders;
+    queryColliders(point, colliders);
+    return colliders;
+}
+
+
+const ColliderSnapshot* ColliderIndex::queryPriorityCollider(const Vector3& point) const
+{
+    int hits[MaxHits];
+    vector<int> extraHits;
+    int numHits = impl->query(point, hits, extraHits);
+    const int* ids = hits;
+    if(numHits < 0) {
+        ids = extraHits.data();
+        numHits = extraHits.size();
+    }
+
+    const ColliderSnapshot* found = nullptr;
+    for(int i = 0; i < numHits; ++i) {
+        const ColliderSnapshot* snapshot = impl->snapshots[ids[i]].get();
+        if(!found || snapshot->priority >= found->priority) {
+            found = snapshot;
+        }
+    }
+    return found;
+}
+
+
+void ColliderIndex::queryBlendWeights
+(const Vector3& point, vector<const ColliderSnapshot*>& out_colliders, vector<double>& out_weights) const
+{
+    queryColliders(point, out_colliders);
+    const int n = out_colliders.size();
+    out_weights.resize(n);
+    for(int i = 0; i < n; ++i) {
+        const ColliderSnapshot* collider = out_colliders[i];
+        double w = 1.0;
+        if(collider->boundaryWidth > 0.0) {
+            const double t = std::min(1.0, std::max(0.0, -collider->shape.signedDistance(point) / collider->boundaryWidth));
+            w = t * t * (3.0 - 2.0 * t);
+        }
+        out_weights[i] = w;
+    }
+    if(n < 2) {
+        return;
+    }
+
+    int order[MaxHits];
+    vector<int> extraOrder;
+    int* ids = order;
+    if(n > MaxHits) {
+        extraOrder.resize(n);
+        ids = extraOrder.data();
+    }
+    for(int i = 0; i < n; ++i) {
+        ids[i] = i;
+    }
+    std::stable_sort(ids, ids + n, [&](int a, int b){
+        return out_colliders[a]->priority > out_colliders[b]->priority; });
+
+    double remaining = 1.0;
+    for(int begin = 0; begin < n; ) {
+        const int priority = out_colliders[ids[begin]]->priority;
+        int end = begin;
+        double sum = 0.0;
+        double max = 0.0;
+        while(end < n && out_colliders[ids[end]]->priority == priority) {
+            sum += out_weights[ids[end]];
+            max = std::max(max, out_weights[ids[end]]);
+            ++end;
+        }
+        // the level covers the point as much as its most covering collider
+        const double share = remaining * max;
+        for(int i = begin; i < end; ++i) {
+            double& w = out_weights[ids[i]];
+            w = sum > 0.0 ? share * w / sum : 0.0;
+        }
+        remaining -= share;
+        begin = end;
+    }
+}
+
+
+void ColliderIndex::queryOverlaps(vector<pair<int, int>>& out_pairs) const
+{
+    out_pairs.clear();
+    auto& boxMin = impl->boxMin;
+    auto& boxMax = impl->boxMax;
+
+    // the colliders whose x intervals still cover the current sweep position
+    vector<int> active;
+    for(auto& j : impl->sweepOrder) {
+        const double x = boxMin[j][0];
+        auto end = std::remove_if(active.begin(), active.end(),
+                                  [&](int i){ return boxMax[i][0] < x; });
+        active.erase(end, active.end());
+
+        for(auto& i : active) {
+            if(boxMin[i][1] > boxMax[j][1] || boxMax[i][1] < boxMin[j][1]
+               || boxMin[i][2] > boxMax[j][2] || boxMax[i][2] < boxMin[j][2]) {
+                continue;
+            }
+            if(impl->snapshots[i]->shape.intersects(impl->snapshots[j]->shape)) {
+                out_pairs.emplace_back(std::min(i, j), std::max(i, j));
+            }
+        }
+        active.push_back(j);
+    }
+    std::sort(out_pairs.begin(), out_pairs.end());
+}
+
+
+void ColliderIndex::queryPoints(const vector<Vector3>& points, vector<uint64_t>& out_masks) const
+{
+    const int numPoints = points.size();
+    const int numWords = CompiledCollider::numMaskWords(numPoints);
+    const int numColliders = impl->snapshots.size();
+    out_masks.assign(numColliders * numWords, 0);
+    if(numPoints == 0) {
+        return;
+    }
+
+    Vector3 min = points[0];
+    Vector3 max = points[0];
+    for(int i = 1; i < numPoints; ++i) {
+        min = min.cwiseMin(points[i]);
+        max = max.cwiseMax(points[i]);
+    }
+
+    for(int j = 0; j < numColliders; ++j) {
+        // the colliders apart from all the points are skipped without testing each point
+        const Vector3& boxMin = impl->boxMin[j];
+        const Vector3& boxMax = impl->boxMax[j];
+        if((boxMin.array() > max.array()).any() || (boxMax.array() < min.array()).any()) {
+            continue;
+        }
+        impl->snapshots[j]->shape.containsPoints(points.data(), numPoints, &out_masks[j * numWords]);
+    }
+}
+
+
+const ColliderSnapshot& ColliderIndex::snapshot(int index) const
+{
+    return *impl->snapshots[index];
+}
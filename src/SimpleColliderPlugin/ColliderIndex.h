@@ -0,0 +1,87 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_INDEX_H
+#define CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_INDEX_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/ItemList>
+#include <utility>
+#include <vector>
+#include "ColliderSnapshot.h"
+#include "MultiColliderItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Bounding volume hierarchy over the bounding boxes of a set of colliders.
+   update() takes the snapshots published by the colliders, and the hierarchy
+   is rebuilt only when the position or the shape of one of them has changed.
+*/
+class CNOID_EXPORT ColliderIndex
+{
+public:
+    ColliderIndex();
+    ColliderIndex(const ColliderIndex& org) = delete;
+    ~ColliderIndex();
+
+    void clear();
+    void setColliders(const ItemList<MultiColliderItem>& colliders);
+    const ItemList<MultiColliderItem>& colliders() const;
+
+    /**
+       Indexes the snapshots made without the items, which needs no GUI. update() keeps
+       them, and the queries returning the items are not available.
+    */
+    void setSnapshots(const std::vector<ColliderSnapshotPtr>& snapshots);
+    bool update();
+
+    // The colliders containing the point in the order of the given collider list
+    void queryColliders(const Vector3& point, std::vector<MultiColliderItem*>& out_colliders) const;
+    void queryColliders(const Vector3& point, std::vector<const ColliderSnapshot*>& out_snapshots) const;
+    std::vector<MultiColliderItem*> queryColliders(const Vector3& point) const;
+
+    /**
+       The collider that takes effect at the point, which is the one with the highest
+       priority among the colliders containing the point. Of the colliders with the same
+       priority, the last one in the collider list is taken. nullptr if there is none.
+    */
+    const ColliderSnapshot* queryPriorityCollider(const Vector3& point) const;
+
+    /**
+       The colliders containing the point with the weights of their effects, which sum to
+       at most one. The weight of a collider rises smoothly from zero on its surface to one
+       at the boundary width inside. The colliders of a higher priority take their share
+       first, the colliders of the same priority share it in proportion to their weights,
+       and the lower priorities fill the rest, so the blended effect is continuous across
+       the boundaries.
+    */
+    void queryBlendWeights(const Vector3& point, std::vector<const ColliderSnapshot*>& out_colliders,
+                           std::vector<double>& out_weights) const;
+
+    /**
+       All the pairs of the colliders whose volumes overlap, found by sweep and prune
+       along the x axis. Each pair is stored as (i, j) with the indices i < j.
+    */
+    void queryOverlaps(std::vector<std::pair<int, int>>& out_pairs) const;
+
+    /**
+       Tests all the points against each collider in one call. The bit (i % 64) of
+       out_masks[j * CompiledCollider::numMaskWords(points.size()) + i / 64]
+       is set when the collider j contains the point i.
+    */
+    void queryPoints(const std::vector<Vector3>& points, std::vector<uint64_t>& out_masks) const;
+
+    // The snapshot of the collider taken at the last update
+    const ColliderSnapshot& snapshot(int index) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif // CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_INDEX_H
@@ -0,0 +1,150 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "ColliderSnapshot.h"
+#include "MultiColliderItem.h"
+
+using namespace std;
+using namespace cnoid;
+
+
+ColliderSnapshot::ColliderSnapshot(MultiColliderItem* item)
+    : item(item),
+      version(0),
+      shape(item)
+{
+    name = item->name();
+    colliderType = item->colliderType();
+    priority = item->priority();
+    boundaryWidth = item->boundaryWidth();
+
+    sceneType = item->sceneType();
+    position = item->position();
+    inversePosition = position.inverse(Eigen::Isometry);
+    size = item->size();
+    radius = item->radius();
+    height = item->height();
+    boundingBox = item->boundingBox();
+
+    density = item->density();
+    viscosity = item->viscosity();
+    steadyFlow = item->steadyFlow();
+    unsteadyFlow = item->unsteadyFlow();
+
+    inboundDelay = item->inboundDelay();
+    inboundRate = item->inboundRate();
+    inboundLoss = item->inboundLoss();
+    outboundDelay = item->outboundDelay();
+    outboundRate = item->outboundRate();
+    outboundLoss = item->outboundLoss();
+    source = item->source();
+    destination = item->destination();
+
+    hsv = item->hsv();
+    rgb = item->rgb();
+    coefB = item->coefB();
+    coefD = item->coefD();
+    stdDev = item->stdDev();
+    saltAmount = item->saltAmount();
+    saltChance = item->saltChance();
+    pepperAmount = item->pepperAmount();
+    pepperChance = item->pepperChance();
+    mosaicChance = item->mosaicChance();
+    kernel = item->kernel();
+}
+
+
+ColliderSnapshot::ColliderSnapshot()
+    : item(nullptr),
+      version(0)
+{
+    colliderType = MultiColliderItem::CFD;
+    priority = 0;
+    boundaryWidth = 0.0;
+
+    sceneType = SimpleColliderItem::BOX;
+    position.setIdentity();
+    size.setZero();
+    radius = 0.0;
+    height = 0.0;
+
+    density = 0.0;
+    viscosity = 0.0;
+    steadyFlow.setZero();
+    unsteadyFlow.setZero();
+
+    inboundDelay = 0.0;
+    inboundRate = 0.0;
+    inboundLoss = 0.0;
+    outboundDelay = 0.0;
+    outboundRate = 0.0;
+    outboundLoss = 0.0;
+
+    hsv.setZero();
+    rgb.setZero();
+    coefB = 0.0;
+    coefD = 0.0;
+    stdDev = 0.0;
+    saltAmount = 0.0;
+    saltChance = 0.0;
+    pepperAmount = 0.0;
+    pepperChance = 0.0;
+    mosaicChance = 0.0;
+    kernel = 0;
+
+    compileShape();
+}
+
+
+void ColliderSnapshot::compileShape(const SignedDistanceFieldPtr& field)
+{
+    inversePosition = position.inverse(Eigen::Isometry);
+    shape.compile(sceneType, position, size, radius, height, field);
+    boundingBox = shape.boundingBox();
+}
+
+
+bool ColliderSnapshot::hasSameGeometry(const ColliderSnapshot& other) const
+{
+    return sceneType == other.sceneType
+        && position.matrix() == other.position.matrix()
+        && size == other.size
+        && radius == other.radius
+        && height == other.height
+        && shape.signedDistanceField() == other.shape.signedDistanceField();
+}
+
+
+bool ColliderSnapshot::hasSameState(const ColliderSnapshot& other) const
+{
+    return item == other.item
+        && name == other.name
+        && colliderType == other.colliderType
+        && priority == other.priority
+        && boundaryWidth == other.boundaryWidth
+        && hasSameGeometry(other)
+        && density == other.density
+        && viscosity == other.viscosity
+        && steadyFlow == other.steadyFlow
+        && unsteadyFlow == other.unsteadyFlow
+        && inboundDelay == other.inboundDelay
+        && inboundRate == other.inboundRate
+        && inboundLoss == other.inboundLoss
+        && outboundDelay == other.outboundDelay
+        && outboundRate == other.outboundRate
+        && outboundLoss == other.outboundLoss
+        && source == other.source
+        && destination == other.destination
+        && hsv == other.hsv
+        && rgb == other.rgb
+        && coefB == other.coefB
+        && coefD == other.coefD
+        && stdDev == other.stdDev
+        && saltAmount == other.saltAmount
+        && saltChance == other.saltChance
+        && pepperAmount == other.pepperAmount
+        && pepperChance == other.pepperChance
+        && mosaicChance == other.mosaicChance
+        && kernel == other.kernel;
+}
@@ -0,0 +1,90 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_SNAPSHOT_H
+#define CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_SNAPSHOT_H
+
+#include <cnoid/BoundingBox>
+#include <cnoid/EigenTypes>
+#include <memory>
+#include <string>
+#include "CompiledCollider.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class MultiColliderItem;
+
+/**
+   Immutable copy of the state of a collider. The item publishes a new
+   snapshot whenever one of its setters changes the state, and the simulation
+   takes the published ones at the beginning of each step, so the state never
+   changes in the middle of a step. The version is incremented only when the state actually differs.
+*/
+struct CNOID_EXPORT ColliderSnapshot
+{
+    ColliderSnapshot(MultiColliderItem* item);
+
+    // A snapshot without an item, whose geometry is set and compiled by compileShape()
+    ColliderSnapshot();
+
+    // Updates the inverse position, the bounding box and the shape from the geometry. A mesh needs its field.
+    void compileShape(const SignedDistanceFieldPtr& field = nullptr);
+
+    bool hasSameGeometry(const ColliderSnapshot& other) const;
+    bool hasSameState(const ColliderSnapshot& other) const;
+
+    // the source collider, used as a key but not to be accessed in the simulation thread, or nullptr
+    MultiColliderItem* item;
+    std::string name;
+    unsigned int version;
+    int colliderType;
+    int priority;
+    double boundaryWidth;
+
+    // geometry
+    int sceneType;
+    Isometry3 position;
+    Isometry3 inversePosition;
+    Vector3 size;
+    double radius;
+    double height;
+    BoundingBox boundingBox;
+    CompiledCollider shape;
+
+    // CFD
+    double density;
+    double viscosity;
+    Vector3 steadyFlow;
+    Vector3 unsteadyFlow;
+
+    // TC
+    double inboundDelay;
+    double inboundRate;
+    double inboundLoss;
+    double outboundDelay;
+    double outboundRate;
+    double outboundLoss;
+    std::string source;
+    std::string destination;
+
+    // VFX
+    Vector3 hsv;
+    Vector3 rgb;
+    double coefB;
+    double coefD;
+    double stdDev;
+    double saltAmount;
+    double saltChance;
+    double pepperAmount;
+    double pepperChance;
+    double mosaicChance;
+    int kernel;
+};
+
+typedef std::shared_ptr<const ColliderSnapshot> ColliderSnapshotPtr;
+
+}
+
+#endif // CNOID_SIMPLECOLLIDER_PLUGIN_COLLIDER_SNAPSHOT_H
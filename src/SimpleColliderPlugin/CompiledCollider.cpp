@@ -0,0 +1,604 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "CompiledCollider.h"
+#include "SimpleColliderItem.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// the points are transposed into blocks of coordinates that Eigen evaluates with vector instructions
+const int BlockSize = 8;
+typedef Eigen::Array<double, BlockSize, 1> Block;
+typedef Eigen::Array<bool, BlockSize, 1> BlockMask;
+
+struct BoxKernel
+{
+    Vector3 h;
+    BlockMask operator()(const Block& x, const Block& y, const Block& z) const {
+        return (x.abs() <= h.x()) && (y.abs() <= h.y()) && (z.abs() <= h.z());
+    }
+};
+
+// the axis of the cylinder is the y axis of the collider frame
+struct CylinderKernel
+{
+    double halfHeight;
+    double r2;
+    BlockMask operator()(const Block& x, const Block& y, const Block& z) const {
+        return (y.abs() < halfHeight) && (x * x + z * z < r2);
+    }
+};
+
+struct SphereKernel
+{
+    double r2;
+    BlockMask operator()(const Block& x, const Block& y, const Block& z) const {
+        return (x * x + y * y + z * z) <= r2;
+    }
+};
+
+template<class Kernel>
+int testPoints(const Vector3& center, const Matrix3& Rt, const Kernel& kernel,
+               const Vector3* points, int numPoints, uint64_t* out_mask)
+{
+    int numInside = 0;
+    Block px, py, pz;
+    for(int begin = 0; begin < numPoints; begin += BlockSize) {
+        const int n = std::min(BlockSize, numPoints - begin);
+        for(int k = 0; k < n; ++k) {
+            const Vector3 d = points[begin + k] - center;
+            px[k] = d.x();
+            py[k] = d.y();
+            pz[k] = d.z();
+        }
+        for(int k = n; k < BlockSize; ++k) {
+            px[k] = py[k] = pz[k] = 0.0;
+        }
+
+        const Block x = Rt(0, 0) * px + Rt(0, 1) * py + Rt(0, 2) * pz;
+        const Block y = Rt(1, 0) * px + Rt(1, 1) * py + Rt(1, 2) * pz;
+        const Block z = Rt(2, 0) * px + Rt(2, 1) * py + Rt(2, 2) * pz;
+        const BlockMask inside = kernel(x, y, z);
+
+        uint64_t bits = 0;
+        for(int k = 0; k < n; ++k) {
+            if(inside[k]) {
+                bits |= (uint64_t)1 << k;
+                ++numInside;
+            }
+        }
+        out_mask[begin / 64] |= bits << (begin % 64);
+    }
+    return numInside;
+}
+
+
+const int MaxGjkIterations = 64;
+
+Vector3 tripleCross(const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    return a.cross(b).cross(c);
+}
+
+// Reduces the simplex to the feature nearest to the origin and updates the search direction.
+// The last point of the simplex is the newest one.
+bool updateSimplex(Vector3* simplex, int& n, Vector3& d)
+{
+    const double eps = 1.0e-20;
+
+    if(n == 2) {
+        const Vector3 a = simplex[1];
+        const Vector3 ab = simplex[0] - a;
+        const Vector3 ao = -a;
+        if(ab.dot(ao) > 0.0) {
+            d = tripleCross(ab, ao, ab);
+            if(d.squaredNorm() < eps) {
+                return true;
+            }
+        } else {
+            simplex[0] = a;
+            n = 1;
+            d = ao;
+        }
+        return false;
+    }
+
+    if(n == 3) {
+        const Vector3 a = simplex[2];
+        const Vector3 b = simplex[1];
+        const Vector3 c = simplex[0];
+        const Vector3 ab = b - a;
+        const Vector3 ac = c - a;
+        const Vector3 ao = -a;
+        const Vector3 abc = ab.cross(ac);
+
+        if(abc.cross(ac).dot(ao) > 0.0) {
+            if(ac.dot(ao) > 0.0) {
+                simplex[0] = c;
+                simplex[1] = a;
+                n = 2;
+                d = tripleCross(ac, ao, ac);
+                return d.squaredNorm() < eps;
+            }
+        } else if(ab.cross(abc).dot(ao) <= 0.0) {
+            const double side = abc.dot(ao);
+            if(fabs(side) < eps) {
+                return true;
+            }
+            d = side > 0.0 ? abc : Vector3(-abc);
+            return false;
+        }
+
+        if(ab.dot(ao) > 0.0) {
+            simplex[0] = b;
+            simplex[1] = a;
+            n = 2;
+            d = tripleCross(ab, ao, ab);
+            return d.squaredNorm() < eps;
+        }
+        simplex[0] = a;
+        n = 1;
+        d = ao;
+        return false;
+    }
+
+    // tetrahedron: find a face with the origin outside
+    const Vector3 a = simplex[3];
+    const Vector3 ao = -a;
+    const int faces[3][3] = { { 2, 1, 0 }, { 1, 0, 2 }, { 0, 2, 1 } };
+    for(auto& face : faces) {
+        const Vector3 b = simplex[face[0]];
+        const Vector3 c = simplex[face[1]];
+        const Vector3 opposite = simplex[face[2]];
+        Vector3 normal = (b - a).cross(c - a);
+        if(normal.dot(opposite - a) > 0.0) {
+            normal = -normal;
+        }
+        if(normal.dot(ao) > 0.0) {
+            simplex[0] = c;
+            simplex[1] = b;
+            simplex[2] = a;
+            n = 3;
+            return updateSimplex(simplex, n, d);
+        }
+    }
+    return true;
+}
+
+// The point of the simplex of up to three points nearest to the origin
+Vector3 closestPointOfSimplex(const Vector3* simplex, int n)
+{
+    const Vector3& a = simplex[0];
+    if(n == 1) {
+        return a;
+    }
+    if(n == 2) {
+        const Vector3 ab = simplex[1] - a;
+        const double length2 = ab.squaredNorm();
+        const double t = length2 > 0.0 ? std::min(1.0, std::max(0.0, -a.dot(ab) / length2)) : 0.0;
+        return a + t * ab;
+    }
+
+    // the Voronoi regions of the triangle
+    const Vector3& b = simplex[1];
+    const Vector3& c = simplex[2];
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const double d1 = -ab.dot(a);
+    const double d2 = -ac.dot(a);
+    if(d1 <= 0.0 && d2 <= 0.0) {
+        return a;
+    }
+    const double d3 = -ab.dot(b);
+    const double d4 = -ac.dot(b);
+    if(d3 >= 0.0 && d4 <= d3) {
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        return a + (d1 / (d1 - d3)) * ab;
+    }
+    const double d5 = -ab.dot(c);
+    const double d6 = -ac.dot(c);
+    if(d6 >= 0.0 && d5 <= d6) {
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        return a + (d2 / (d2 - d6)) * ac;
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Gilbert-Johnson-Keerthi test whether the Minkowski difference contains the origin
+bool intersectsConvex(const CompiledCollider& collider1, const CompiledCollider& collider2, const Vector3& direction)
+{
+    auto support = [&](const Vector3& d){ return collider1.support(d) - collider2.support(-d); };
+
+    Vector3 d = direction.squaredNorm() > 0.0 ? direction : Vector3(Vector3::UnitX());
+    Vector3 simplex[4];
+    int n = 0;
+    simplex[n++] = support(d);
+    d = -simplex[0];
+    double scale = simplex[0].norm();
+    for(int i = 0; i < MaxGjkIterations; ++i) {
+        if(d.squaredNorm() < 1.0e-20) {
+            return true;
+        }
+        const Vector3 p = support(d);
+        if(p.dot(d) < 0.0) {
+            return false;
+        }
+        scale = std::max(scale, p.norm());
+        simplex[n++] = p;
+        if(updateSimplex(simplex, n, d)) {
+            return true;
+        }
+    }
+
+    /*
+       The iteration does not converge when the surfaces nearly touch. The simplex
+       lies in the Minkowski difference, so the distance from the origin to its
+       nearest point bounds the distance between the volumes from above, and the
+       volumes are taken as touching only when that distance is negligible.
+    */
+    return closestPointOfSimplex(simplex, n).norm() <= 1.0e-6 * scale;
+}
+
+}
+
+
+CompiledCollider::CompiledCollider()
+{
+    sceneType_ = -1;
+    center.setZero();
+    Rt.setIdentity();
+    halfExtents.setZero();
+    halfHeight = 0.0;
+    radius = 0.0;
+}
+
+
+CompiledCollider::CompiledCollider(SimpleColliderItem* collider)
+{
+    compile(collider);
+}
+
+
+void CompiledCollider::compile(SimpleColliderItem* collider)
+{
+    SignedDistanceFieldPtr field;
+    if(collider->sceneType() == SimpleColliderItem::MESH) {
+        field = collider->signedDistanceField();
+    }
+    compile(collider->sceneType(), collider->position(), collider->size(), collider->radius(), collider->height(), field);
+}
+
+
+void CompiledCollider::compile
+(int sceneType, const Isometry3& position, const Vector3& size, double radius, double height,
+ const SignedDistanceFieldPtr& field)
+{
+    sceneType_ = sceneType;
+    center = position.translation();
+    Rt = position.linear().transpose();
+    halfExtents = size / 2.0;
+    halfHeight = fabs(height) / 2.0;
+    this->radius = radius;
+    this->field.reset();
+    if(sceneType_ == SimpleColliderItem::MESH) {
+        this->field = field;
+    }
+}
+
+
+bool CompiledCollider::contains(const Vector3& point) const
+{
+    const Vector3 d = point - center;
+    switch(sceneType_) {
+    case SimpleColliderItem::BOX:
+    {
+        const Vector3 q = Rt * d;
+        return (fabs(q.x()) <= halfExtents.x()) && (fabs(q.y()) <= halfExtents.y())
+            && (fabs(q.z()) <= halfExtents.z());
+    }
+    case SimpleColliderItem::CYLINDER:
+    {
+        const Vector3 q = Rt * d;
+        return (fabs(q.y()) < halfHeight) && (q.x() * q.x() + q.z() * q.z() < radius * radius);
+    }
+    case SimpleColliderItem::SPHERE:
+        return d.norm() <= radius;
+    case SimpleColliderItem::MESH:
+        return field && field->contains(Rt * d);
+    default:
+        break;
+    }
+    return false;
+}
+
+
+double CompiledCollider::signedDistance(const Vector3& point) const
+{
+    const Vector3 d = point - center;
+    switch(sceneType_) {
+    case SimpleColliderItem::BOX:
+    {
+        const Vector3 q = (Rt * d).cwiseAbs() - halfExtents;
+        return q.cwiseMax(0.0).norm() + std::min(q.maxCoeff(), 0.0);
+    }
+    case SimpleColliderItem::CYLINDER:
+    {
+        const Vector3 q = Rt * d;
+        const double axial = fabs(q.y()) - halfHeight;
+        const double radial = sqrt(q.x() * q.x() + q.z() * q.z()) - radius;
+        const double outside = sqrt(std::max(axial, 0.0) * std::max(axial, 0.0)
+                                    + std::max(radial, 0.0) * std::max(radial, 0.0));
+        return outside + std::min(std::max(axial, radial), 0.0);
+    }
+    case SimpleColliderItem::SPHERE:
+        return d.norm() - radius;
+    case SimpleColliderItem::MESH:
+        if(field) {
+            return field->distance(Rt * d);
+        }
+        break;
+    default:
+        break;
+    }
+    return HUGE_VAL;
+}
+
+
+int CompiledCollider::containsPoints(const Vector3* points, int numPoints, uint64_t* out_mask) const
+{
+    std::fill(out_mask, out_mask + numMaskWords(numPoints), 0);
+
+    switch(sceneType_) {
+    case SimpleColliderItem::BOX:
+        return testPoints(center, Rt, BoxKernel{ halfExtents }, points, numPoints, out_mask);
+    case SimpleColliderItem::CYLINDER:
+        return testPoints(center, Rt, CylinderKernel{ halfHeight, radius * radius }, points, numPoints, out_mask);
+    case SimpleColliderItem::SPHERE:
+        if(radius < 0.0) {
+            return 0;
+        }
+        // the distance does not depend on the rotation
+        return testPoints(center, Matrix3::Identity(), SphereKernel{ radius * radius }, points, numPoints, out_mask);
+    case SimpleColliderItem::MESH:
+    {
+        // a lookup per point is already independent of the mesh
+        int numInside = 0;
+        for(int i = 0; i < numPoints; ++i) {
+            if(contains(points[i])) {
+                out_mask[i / 64] |= (uint64_t)1 << (i % 64);
+                ++numInside;
+            }
+        }
+        return numInside;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
+
+int CompiledCollider::containsPoints(const vector<Vector3>& points, vector<uint64_t>& out_mask) const
+{
+    out_mask.resize(numMaskWords(points.size()));
+    return containsPoints(points.data(), points.size(), out_mask.data());
+}
+
+
+Vector3 CompiledCollider::support(const Vector3& direction) const
+{
+    switch(sceneType_) {
+    case SimpleColliderItem::BOX:
+    {
+        const Vector3 d = Rt * direction;
+        Vector3 p;
+        for(int i = 0; i < 3; ++i) {
+            p[i] = d[i] >= 0.0 ? halfExtents[i] : -halfExtents[i];
+        }
+        return center + Rt.transpose() * p;
+    }
+    case SimpleColliderItem::CYLINDER:
+    {
+        const Vector3 d = Rt * direction;
+        Vector3 p(0.0, d.y() >= 0.0 ? halfHeight : -halfHeight, 0.0);
+        const double r = sqrt(d.x() * d.x() + d.z() * d.z());
+        if(r > 0.0) {
+            p.x() = radius * d.x() / r;
+            p.z() = radius * d.z() / r;
+        }
+        return center + Rt.transpose() * p;
+    }
+    case SimpleColliderItem::SPHERE:
+    {
+        const double norm = direction.norm();
+        return norm > 0.0 ? Vector3(center + direction * (radius / norm)) : center;
+    }
+    case SimpleColliderItem::MESH:
+    {
+        // the bounding box of the mesh
+        if(!field) {
+            return center;
+        }
+        const Vector3 d = Rt * direction;
+        Vector3 p;
+        for(int i = 0; i < 3; ++i) {
+            p[i] = d[i] >= 0.0 ? field->max()[i] : field->min()[i];
+        }
+        return center + Rt.transpose() * p;
+    }
+    default:
+        break;
+    }
+    return center;
+}
+
+
+BoundingBox CompiledCollider::boundingBox() const
+{
+    // the support points along the axes give the extents of the box
+    Vector3 min, max;
+    for(int i = 0; i < 3; ++i) {
+        const Vector3 axis = Vector3::Unit(i);
+        min[i] = support(-axis)[i];
+        max[i] = support(axis)[i];
+    }
+    return BoundingBox(min, max);
+}
+
+
+double CompiledCollider::squaredDistance(const Vector3& point) const
+{
+    const Vector3 d = point - center;
+    switch(sceneType_) {
+    case SimpleColliderItem::BOX:
+    {
+        const Vector3 q = Rt * d;
+        return (q.cwiseAbs() - halfExtents).cwiseMax(0.0).squaredNorm();
+    }
+    case SimpleColliderItem::CYLINDER:
+    {
+        const Vector3 q = Rt * d;
+        const double axial = std::max(0.0, fabs(q.y()) - halfHeight);
+        const double radial = std::max(0.0, sqrt(q.x() * q.x() + q.z() * q.z()) - radius);
+        return axial * axial + radial * radial;
+    }
+    case SimpleColliderItem::SPHERE:
+    {
+        const double distance = std::max(0.0, d.norm() - radius);
+        return distance * distance;
+    }
+    case SimpleColliderItem::MESH:
+    {
+        // a lower bound beyond the band of the field
+        if(!field) {
+            return HUGE_VAL;
+        }
+        const double distance = std::max(0.0, field->distance(Rt * d));
+        return distance * distance;
+    }
+    default:
+        break;
+    }
+    return HUGE_VAL;
+}
+
+
+bool CompiledCollider::boxIntersectsBox(const CompiledCollider& other) const
+{
+    // separating axis test over the face normals of both boxes and their edge cross products
+    const double eps = 1.0e-9;
+    const Vector3& a = halfExtents;
+    const Vector3& b = other.halfExtents;
+    const Matrix3 R = Rt * other.Rt.transpose();
+    const Matrix3 absR = R.cwiseAbs().array() + eps;
+    const Vector3 t = Rt * (other.center - center);
+
+    for(int i = 0; i < 3; ++i) {
+        if(fabs(t[i]) > a[i] + absR.row(i).dot(b)) {
+            return false;
+        }
+    }
+    for(int j = 0; j < 3; ++j) {
+        if(fabs(t.dot(R.col(j))) > absR.col(j).dot(a) + b[j]) {
+            return false;
+        }
+    }
+    for(int i = 0; i < 3; ++i) {
+        const int i1 = (i + 1) % 3;
+        const int i2 = (i + 2) % 3;
+        for(int j = 0; j < 3; ++j) {
+            const int j1 = (j + 1) % 3;
+            const int j2 = (j + 2) % 3;
+            const double ra = a[i1] * absR(i2, j) + a[i2] * absR(i1, j);
+            const double rb = b[j1] * absR(i, j2) + b[j2] * absR(i, j1);
+            if(fabs(t[i2] * R(i1, j) - t[i1] * R(i2, j)) > ra + rb) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool CompiledCollider::meshIntersects(const CompiledCollider& other) const
+{
+    if(!field) {
+        return false;
+    }
+
+    // the volumes overlap when the surface of the mesh touches the other volume
+    // or the other volume is inside the mesh, up to the resolution of the field
+    const double tolerance = 0.5 * sqrt(3.0) * field->voxelSize();
+    const Matrix3 R = Rt.transpose();
+    if(other.sceneType_ == SimpleColliderItem::MESH) {
+        if(!other.field) {
+            return false;
+        }
+        for(auto& p : other.field->surfacePoints()) {
+            if(field->distance(Rt * (other.center + other.Rt.transpose() * p - center)) <= tolerance) {
+                return true;
+            }
+        }
+        const double otherTolerance = 0.5 * sqrt(3.0) * other.field->voxelSize();
+        for(auto& p : field->surfacePoints()) {
+            if(other.field->distance(other.Rt * (center + R * p - other.center)) <= otherTolerance) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if(contains(other.center)) {
+        return true;
+    }
+    const double tolerance2 = tolerance * tolerance;
+    for(auto& p : field->surfacePoints()) {
+        if(other.squaredDistance(center + R * p) <= tolerance2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool CompiledCollider::intersects(const CompiledCollider& other) const
+{
+    const int type1 = sceneType_;
+    const int type2 = other.sceneType_;
+    if(type1 < 0 || type2 < 0) {
+        return false;
+    }
+
+    if(type1 == SimpleColliderItem::MESH) {
+        return meshIntersects(other);
+    } else if(type2 == SimpleColliderItem::MESH) {
+        return other.meshIntersects(*this);
+    }
+
+    if(type1 == SimpleColliderItem::SPHERE) {
+        return other.squaredDistance(center) <= radius * radius;
+    } else if(type2 == SimpleColliderItem::SPHERE) {
+        return squaredDistance(other.center) <= other.radius * other.radius;
+    } else if(type1 == SimpleColliderItem::BOX && type2 == SimpleColliderItem::BOX) {
+        return boxIntersectsBox(other);
+    }
+    // the pairs including a cylinder have no closed form
+    return intersectsConvex(*this, other, other.center - center);
+}
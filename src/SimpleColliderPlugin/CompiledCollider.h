@@ -0,0 +1,80 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_SIMPLECOLLIDER_PLUGIN_COMPILED_COLLIDER_H
+#define CNOID_SIMPLECOLLIDER_PLUGIN_COMPILED_COLLIDER_H
+
+#include <cnoid/BoundingBox>
+#include <cnoid/EigenTypes>
+#include <cstdint>
+#include <vector>
+#include "SignedDistanceField.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SimpleColliderItem;
+
+/**
+   Snapshot of the volume of a collider prepared for point tests.
+   The inverse rotation, the half extents and the axis are computed once,
+   and the points are tested in blocks with a kernel specialized for the
+   shape. The snapshot must be compiled again when the collider moves.
+   A mesh collider shares the distance field of the item, which is immutable.
+*/
+class CNOID_EXPORT CompiledCollider
+{
+public:
+    CompiledCollider();
+    CompiledCollider(SimpleColliderItem* collider);
+
+    void compile(SimpleColliderItem* collider);
+    // Compiles the shape given without an item. A mesh needs its distance field.
+    void compile(int sceneType, const Isometry3& position, const Vector3& size, double radius, double height,
+                 const SignedDistanceFieldPtr& field = nullptr);
+
+    int sceneType() const { return sceneType_; }
+    const SignedDistanceFieldPtr& signedDistanceField() const { return field; }
+    bool contains(const Vector3& point) const;
+    // Negative inside, and the exact distance to the surface except for a mesh beyond the band of its field
+    double signedDistance(const Vector3& point) const;
+
+    /**
+       Tests the points and sets the bit (i % 64) of out_mask[i / 64] for each point i inside.
+       @param out_mask array of at least (numPoints + 63) / 64 words
+       @return the number of the points inside
+    */
+    int containsPoints(const Vector3* points, int numPoints, uint64_t* out_mask) const;
+    int containsPoints(const std::vector<Vector3>& points, std::vector<uint64_t>& out_mask) const;
+
+    static int numMaskWords(int numPoints) { return (numPoints + 63) / 64; }
+    static bool testBit(const uint64_t* mask, int index) { return (mask[index / 64] >> (index % 64)) & 1; }
+
+    // Whether the volumes of the colliders overlap, including touching
+    bool intersects(const CompiledCollider& other) const;
+
+    // The farthest point of the volume in the direction
+    Vector3 support(const Vector3& direction) const;
+
+    // The axis-aligned box enclosing the volume
+    BoundingBox boundingBox() const;
+
+private:
+    bool boxIntersectsBox(const CompiledCollider& other) const;
+    bool meshIntersects(const CompiledCollider& other) const;
+    double squaredDistance(const Vector3& point) const;
+
+    int sceneType_;
+    Vector3 center;
+    // rotation from the world frame to the collider frame
+    Matrix3 Rt;
+    Vector3 halfExtents;
+    double halfHeight;
+    double radius;
+    SignedDistanceFieldPtr field;
+};
+
+}
+
+#endif // CNOID_SIMPLECOLLIDER_PLUGIN_COMPILED_COLLIDER_H
@@ -13,6 +13,7 @@ CFDEffect::CFDEffect()
     viscosity_ = 0.0;
     steadyFlow_ << 0.0, 0.0, 0.0;
     unsteadyFlow_ << 0.0, 0.0, 0.0;
+    flowFieldFile_ = "";
 }
 
 
@@ -22,6 +23,7 @@ CFDEffect::CFDEffect(const CFDEffect& org)
     viscosity_ = org.viscosity_;
     steadyFlow_ = org.steadyFlow_;
     unsteadyFlow_ = org.unsteadyFlow_;
+    flowFieldFile_ = org.flowFieldFile_;
 }
 
 
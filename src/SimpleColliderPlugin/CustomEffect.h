@@ -16,21 +16,29 @@ class CNOID_EXPORT CFDEffect
 public:
     CFDEffect();
     CFDEffect(const CFDEffect& org);
+    virtual ~CFDEffect() { }
 
-    void setDensity(const double& density) { density_ = density; }
+    void setDensity(const double& density) { density_ = density; onEffectChanged(); }
     double density() const { return density_; }
-    void setViscosity(const double& viscosity) { viscosity_ = viscosity; }
+    void setViscosity(const double& viscosity) { viscosity_ = viscosity; onEffectChanged(); }
     double viscosity() const { return viscosity_; }
-    void setSteadyFlow(const Vector3& steadyFlow) { steadyFlow_ = steadyFlow; }
+    void setSteadyFlow(const Vector3& steadyFlow) { steadyFlow_ = steadyFlow; onEffectChanged(); }
     Vector3 steadyFlow() const { return steadyFlow_; }
-    void setUnsteadyFlow(const Vector3& unsteadyFlow) { unsteadyFlow_ = unsteadyFlow; }
+    void setUnsteadyFlow(const Vector3& unsteadyFlow) { unsteadyFlow_ = unsteadyFlow; onEffectChanged(); }
     Vector3 unsteadyFlow() const { return unsteadyFlow_; }
+    void setFlowFieldFile(const std::string& flowFieldFile) { flowFieldFile_ = flowFieldFile; onEffectChanged(); }
+    std::string flowFieldFile() const { return flowFieldFile_; }
+
+protected:
+    // Called after one of the parameters is set
+    virtual void onEffectChanged() { }
 
 private:
     double density_;
     double viscosity_;
     Vector3 steadyFlow_;
     Vector3 unsteadyFlow_;
+    std::string flowFieldFile_;
 };
 
 class CNOID_EXPORT TCEffect
@@ -38,24 +46,29 @@ class CNOID_EXPORT TCEffect
 public:
     TCEffect();
     TCEffect(const TCEffect& org);
+    virtual ~TCEffect() { }
 
-    void setInboundDelay(const double& inboundDelay) { inboundDelay_ = inboundDelay; }
+    void setInboundDelay(const double& inboundDelay) { inboundDelay_ = inboundDelay; onEffectChanged(); }
     double inboundDelay() const { return inboundDelay_; }
-    void setInboundRate(const double& inboundRate) { inboundRate_ = inboundRate; }
+    void setInboundRate(const double& inboundRate) { inboundRate_ = inboundRate; onEffectChanged(); }
     double inboundRate() const { return inboundRate_; }
-    void setInboundLoss(const double& inboundLoss) { inboundLoss_ = inboundLoss; }
+    void setInboundLoss(const double& inboundLoss) { inboundLoss_ = inboundLoss; onEffectChanged(); }
     double inboundLoss() const { return inboundLoss_; }
-    void setOutboundDelay(const double& outboundDelay) { outboundDelay_ = outboundDelay; }
+    void setOutboundDelay(const double& outboundDelay) { outboundDelay_ = outboundDelay; onEffectChanged(); }
     double outboundDelay() const { return outboundDelay_; }
-    void setOutboundRate(const double& outboundRate) { outboundRate_ = outboundRate; }
+    void setOutboundRate(const double& outboundRate) { outboundRate_ = outboundRate; onEffectChanged(); }
     double outboundRate() const { return outboundRate_; }
-    void setOutboundLoss(const double& outboundLoss) { outboundLoss_ = outboundLoss; }
+    void setOutboundLoss(const double& outboundLoss) { outboundLoss_ = outboundLoss; onEffectChanged(); }
     double outboundLoss() const { return outboundLoss_; }
-    void setSource(const std::string& source) { source_ = source; }
+    void setSource(const std::string& source) { source_ = source; onEffectChanged(); }
     std::string source() const { return source_; }
-    void setDestination(const std::string& destination){ destination_ = destination; }
+    void setDestination(const std::string& destination){ destination_ = destination; onEffectChanged(); }
     std::string destination() const { return destination_; }
 
+protected:
+    // Called after one of the parameters is set
+    virtual void onEffectChanged() { }
+
 private:
     double inboundDelay_;
     double inboundRate_;
@@ -72,32 +85,37 @@ class CNOID_EXPORT VisualEffect
 public:
     VisualEffect();
     VisualEffect(const VisualEffect& org);
+    virtual ~VisualEffect() { }
 
-    void setHsv(const Vector3& hsv) { hsv_ = hsv; }
+    void setHsv(const Vector3& hsv) { hsv_ = hsv; onEffectChanged(); }
     Vector3 hsv() const { return hsv_; }
-    void setRgb(const Vector3& rgb) { rgb_ = rgb; }
+    void setRgb(const Vector3& rgb) { rgb_ = rgb; onEffectChanged(); }
     Vector3 rgb() const { return rgb_; }
-    void setCoefB(const double coef_b) { coef_b_ = coef_b; }
+    void setCoefB(const double coef_b) { coef_b_ = coef_b; onEffectChanged(); }
     double coefB() const { return coef_b_; }
-    void setCoefD(const double& coef_d) { coef_d_ = coef_d; }
+    void setCoefD(const double& coef_d) { coef_d_ = coef_d; onEffectChanged(); }
     double coefD() const { return coef_d_; }
-    void setStdDev(const double& std_dev) { std_dev_ = std_dev; }
+    void setStdDev(const double& std_dev) { std_dev_ = std_dev; onEffectChanged(); }
     double stdDev() const { return std_dev_; }
-    void setSaltAmount(const double& salt_amount) { salt_amount_ = salt_amount; }
+    void setSaltAmount(const double& salt_amount) { salt_amount_ = salt_amount; onEffectChanged(); }
     double saltAmount() const { return salt_amount_; }
-    void setSaltChance(const double& salt_chance) { salt_chance_ = salt_chance; }
+    void setSaltChance(const double& salt_chance) { salt_chance_ = salt_chance; onEffectChanged(); }
     double saltChance() const { return salt_chance_; }
-    void setPepperAmount(const double& pepper_amount) { pepper_amount_ = pepper_amount; }
+    void setPepperAmount(const double& pepper_amount) { pepper_amount_ = pepper_amount; onEffectChanged(); }
     double pepperAmount() const { return pepper_amount_; }
-    void setPepperChance(const double& pepper_chance) { pepper_chance_ = pepper_chance; }
+    void setPepperChance(const double& pepper_chance) { pepper_chance_ = pepper_chance; onEffectChanged(); }
     double pepperChance() const { return pepper_chance_; }
-    void setMosaicChance(const double& mosaic_chance) { mosaic_chance_ = mosaic_chance; }
+    void setMosaicChance(const double& mosaic_chance) { mosaic_chance_ = mosaic_chance; onEffectChanged(); }
     double mosaicChance() const { return mosaic_chance_; }
-    void setKernel(const int& kernel) { kernel_ = kernel; }
+    void setKernel(const int& kernel) { kernel_ = kernel; onEffectChanged(); }
     int kernel() const { return kernel_; }
 
     bool readCameraInfo(const Mapping* info);
 
+protected:
+    // Called after one of the parameters is set
+    virtual void onEffectChanged() { }
+
 private:
     Vector3 hsv_;
     Vector3 rgb_;
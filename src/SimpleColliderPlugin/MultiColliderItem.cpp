@@ -24,6 +24,9 @@ MultiColliderItem::MultiColliderItem()
     colliderTypeSelection.setSymbol(TC, N_("TC"));
     colliderTypeSelection.setSymbol(VFX, N_("VFX"));
     colliderTypeSelection.select(CFD);
+    priority_ = 0;
+    boundaryWidth_ = 0.0;
+    publishSnapshot();
 }
 
 
@@ -34,6 +37,8 @@ MultiColliderItem::MultiColliderItem(const MultiColliderItem& org)
       VisualEffect(org)
 {
     colliderTypeSelection = org.colliderTypeSelection;
+    priority_ = org.priority_;
+    boundaryWidth_ = org.boundaryWidth_;
 
     switch(colliderTypeSelection.which()) {
     case CFD:
@@ -49,6 +54,7 @@ MultiColliderItem::MultiColliderItem(const MultiColliderItem& org)
     default:
         break;
     }
+    publishSnapshot();
 }
 
 
@@ -62,6 +68,58 @@ bool MultiColliderItem::setColliderType(int colliderId)
 }
 
 
+void MultiColliderItem::setPriority(int priority)
+{
+    priority_ = priority;
+    publishSnapshot();
+}
+
+
+void MultiColliderItem::setBoundaryWidth(double width)
+{
+    boundaryWidth_ = width;
+    publishSnapshot();
+}
+
+
+bool MultiColliderItem::publishSnapshot()
+{
+    ColliderSnapshotPtr current = std::atomic_load(&snapshot_);
+    auto snapshot = std::make_shared<ColliderSnapshot>(this);
+    if(current && snapshot->hasSameState(*current)) {
+        return false;
+    }
+    snapshot->version = current ? current->version + 1 : 0;
+    std::atomic_store(&snapshot_, ColliderSnapshotPtr(snapshot));
+    return true;
+}
+
+
+ColliderSnapshotPtr MultiColliderItem::snapshot() const
+{
+    return std::atomic_load(&snapshot_);
+}
+
+
+void MultiColliderItem::notifyUpdate()
+{
+    SimpleColliderItem::notifyUpdate();
+    publishSnapshot();
+}
+
+
+void MultiColliderItem::onShapeChanged()
+{
+    publishSnapshot();
+}
+
+
+void MultiColliderItem::onEffectChanged()
+{
+    publishSnapshot();
+}
+
+
 Item* MultiColliderItem::doCloneItem(CloneMap* cloneMap) const
 {
     return new MultiColliderItem(*this);
@@ -73,6 +131,8 @@ void MultiColliderItem::doPutProperties(PutPropertyFunction& putProperty)
     SimpleColliderItem::doPutProperties(putProperty);
     putProperty(_("Collider type"), colliderTypeSelection,
                 [this](int which){ return setColliderType(which); });
+    putProperty(_("Priority"), priority_, changeProperty(priority_));
+    putProperty.min(0.0)(_("Boundary width"), boundaryWidth_, changeProperty(boundaryWidth_));
 
     int colliderId = colliderType();
     switch(colliderId) {
@@ -98,6 +158,12 @@ void MultiColliderItem::doPutProperties(PutPropertyFunction& putProperty)
                         }
                         return false;
                     });
+
+        putProperty(_("flow field file"), FilePathProperty(flowFieldFile()),
+                    [this](const string& filename){
+                        setFlowFieldFile(filename);
+                        return true;
+                    });
         break;
     case TC:
         putProperty.min(0.0).max(100000.0)(_("inbound delay"), inboundDelay(),
@@ -235,11 +301,16 @@ bool MultiColliderItem::store(Archive& archive)
         return false;
     }
     archive.write("collider_type", colliderTypeSelection.selectedSymbol());
+    archive.write("priority", priority_);
+    archive.write("boundary_width", boundaryWidth_);
 
     // CFD
     archive.write("density", density());
     archive.write("viscosity", viscosity());
     write(archive, "steady_flow", Vector3(steadyFlow()));
+    if(!flowFieldFile().empty()) {
+        archive.writeRelocatablePath("flow_field_file", flowFieldFile());
+    }
 
     // TC
     archive.write("inbound_delay", inboundDelay());
@@ -276,6 +347,8 @@ bool MultiColliderItem::restore(const Archive& archive)
     if(archive.read("collider_type", colliderId)) {
         colliderTypeSelection.select(colliderId);
     }
+    archive.read("priority", priority_);
+    archive.read("boundary_width", boundaryWidth_);
 
     // CFD
     setDensity(archive.get("density", 0.0));
@@ -284,6 +357,10 @@ bool MultiColliderItem::restore(const Archive& archive)
     if(read(archive, "steady_flow", v)) {
         setSteadyFlow(v);
     }
+    string filename;
+    if(archive.read("flow_field_file", filename)) {
+        setFlowFieldFile(archive.resolveRelocatablePath(filename));
+    }
 
     // TC
     setInboundDelay(archive.get("inbound_delay", 0.0));
@@ -312,5 +389,6 @@ bool MultiColliderItem::restore(const Archive& archive)
     setMosaicChance(archive.get("mosaic_chance", 0.0));
     setKernel(archive.get("kernel", 16));
 
+    publishSnapshot();
     return true;
 }
@@ -7,6 +7,7 @@
 
 #include <cnoid/Selection>
 #include "SimpleColliderItem.h"
+#include "ColliderSnapshot.h"
 #include "CustomEffect.h"
 #include "exportdecl.h"
 
@@ -24,8 +25,27 @@ public:
     enum ColliderId { CFD, TC, VFX };
     bool setColliderType(int colliderId);
     int colliderType() const { return colliderTypeSelection.which(); }
+    // The collider with the higher priority takes effect where colliders overlap
+    void setPriority(int priority);
+    int priority() const { return priority_; }
+    // Width of the layer inside the surface over which the effect fades in, 0 for a sharp boundary
+    void setBoundaryWidth(double width);
+    double boundaryWidth() const { return boundaryWidth_; }
+
+    /**
+       Publishes the current state when it differs from the last snapshot.
+       The setters of the geometry and the effects call this, so the change
+       reaches the simulation in the next step without notifyUpdate().
+    */
+    bool publishSnapshot();
+    // The last published snapshot, which may be read from any thread
+    ColliderSnapshotPtr snapshot() const;
+
+    virtual void notifyUpdate() override;
 
 protected:
+    virtual void onShapeChanged() override;
+    virtual void onEffectChanged() override;
     virtual Item* doCloneItem(CloneMap* cloneMap) const override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
@@ -33,6 +53,9 @@ protected:
 
 private:
     Selection colliderTypeSelection;
+    int priority_;
+    double boundaryWidth_;
+    ColliderSnapshotPtr snapshot_;
 };
 
 typedef ref_ptr<MultiColliderItem> MultiColliderItemPtr;
@@ -0,0 +1,785 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "SignedDistanceField.h"
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/SceneLoader>
+#include <cnoid/Format>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char FileMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'S', 'D', 'F' };
+const uint32_t FileVersion = 2;
+
+// the exact distances are kept within this number of voxels from the surface
+const int BandVoxels = 3;
+
+// The grid is divided into bricks of BrickSize^3 cells. A brick stores the grid points
+// of its cells including those shared with the next bricks, so a cell is never split.
+const int BrickSize = 8;
+const int BrickPoints = BrickSize + 1;
+const int BrickVolume = BrickPoints * BrickPoints * BrickPoints;
+
+// the entries of the brick table for the bricks apart from the band
+const int32_t OutsideBrick = -1;
+const int32_t InsideBrick = -2;
+const int32_t MarkedBrick = std::numeric_limits<int32_t>::max();
+
+struct RegistryEntry
+{
+    weak_ptr<const SignedDistanceField> field;
+    int64_t fileSize;
+    int64_t fileTime;
+};
+
+std::mutex registryMutex;
+unordered_map<string, RegistryEntry> registry;
+
+Vector3 closestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const Vector3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if(d1 <= 0.0 && d2 <= 0.0) {
+        return a;
+    }
+
+    const Vector3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if(d3 >= 0.0 && d4 <= d3) {
+        return b;
+    }
+
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const Vector3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if(d6 >= 0.0 && d5 <= d6) {
+        return c;
+    }
+
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+template<typename T>
+void writeValue(ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(istream& is, T& value)
+{
+    is.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(is);
+}
+
+
+/*
+   The field of a mesh file is cached under the user cache directory instead of
+   next to the mesh, whose directory may be read-only or shared. The name is a
+   hash of the path and the voxel size, and the file keeps the path to detect
+   a collision of the hashes.
+*/
+filesystem::path cacheFilePath(const string& meshFile, double voxelSize)
+{
+    const char* home = getenv("HOME");
+    if(!home) {
+        return filesystem::path();
+    }
+    uint64_t key = 14695981039346656037ULL;
+    auto hash = [&](const void* data, size_t size){
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < size; ++i) {
+            key = (key ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    hash(meshFile.data(), meshFile.size());
+    hash(&voxelSize, sizeof(voxelSize));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.sdf", (unsigned long long)key);
+    return filesystem::path(fromUTF8(home)) / ".cache" / "choreonoid" / "sdf" / name;
+}
+
+// The bricks sharing the grid points from first to last along an axis
+inline void getBrickRange(int first, int last, int numBricks, int& out_begin, int& out_end)
+{
+    out_begin = (std::max(first, 1) - 1) / BrickSize;
+    out_end = std::min(numBricks, last / BrickSize + 1);
+}
+
+}
+
+
+namespace cnoid {
+
+class SignedDistanceField::Impl
+{
+public:
+    Impl();
+
+    double voxelSize;
+    double bandWidth;
+    Vector3 origin;
+    // the numbers of the grid points
+    int nx;
+    int ny;
+    int nz;
+    // the numbers of the bricks
+    int bx;
+    int by;
+    int bz;
+    // index of the values of each brick, or OutsideBrick or InsideBrick
+    vector<int32_t> brickTable;
+    vector<float> values;
+    Vector3 min;
+    Vector3 max;
+    vector<Vector3> vertices;
+    vector<int> triangles;
+    vector<Vector3> surfacePoints;
+
+    void initializeGrid();
+    void voxelize();
+    template<class Function> void forEachSlab(const Function& func);
+    void markBricks(int bkBegin, int bkEnd);
+    void voxelizeSlab(int bkBegin, int bkEnd);
+    void extractSurfacePoints();
+    bool read(const string& filename, const string& meshFile, int64_t fileSize, int64_t fileTime, double voxelSize);
+    int brickIndex(int bi, int bj, int bk) const { return (bk * by + bj) * bx + bi; }
+    float* brickValues(int32_t brick) { return &values[(size_t)brick * BrickVolume]; }
+    static int pointIndex(int li, int lj, int lk) { return (lk * BrickPoints + lj) * BrickPoints + li; }
+};
+
+}
+
+
+SignedDistanceField::SignedDistanceField()
+{
+    impl = new Impl;
+}
+
+
+SignedDistanceField::Impl::Impl()
+    : voxelSize(0.0),
+      bandWidth(0.0),
+      origin(Vector3::Zero()),
+      nx(0),
+      ny(0),
+      nz(0),
+      bx(0),
+      by(0),
+      bz(0),
+      min(Vector3::Zero()),
+      max(Vector3::Zero())
+{
+
+}
+
+
+SignedDistanceField::~SignedDistanceField()
+{
+    delete impl;
+}
+
+
+SignedDistanceFieldPtr SignedDistanceField::load
+(const string& filename, double voxelSize, string& out_errorMessage)
+{
+    QFileInfo info(filename.c_str());
+    string path = info.canonicalFilePath().toStdString();
+    if(path.empty()) {
+        out_errorMessage = formatR(_("Mesh file \"{0}\" does not exist."), filename);
+        return nullptr;
+    }
+    if(!(voxelSize > 0.0)) {
+        out_errorMessage = formatR(_("The voxel size of \"{0}\" must be positive."), filename);
+        return nullptr;
+    }
+    const int64_t fileSize = info.size();
+    const int64_t fileTime = info.lastModified().toMSecsSinceEpoch();
+    const string key = formatC("{0}:{1}", path, voxelSize);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    auto p = registry.find(key);
+    if(p != registry.end()) {
+        const RegistryEntry& entry = p->second;
+        if(entry.fileSize == fileSize && entry.fileTime == fileTime) {
+            if(auto field = entry.field.lock()) {
+                return field;
+            }
+        }
+    }
+
+    const filesystem::path cachePath = cacheFilePath(path, voxelSize);
+    shared_ptr<SignedDistanceField> field(new SignedDistanceField);
+    if(cachePath.empty() || !field->impl->read(cachePath.string(), path, fileSize, fileTime, voxelSize)) {
+        SceneLoader loader;
+        SgNodePtr scene = loader.load(path);
+        if(!scene) {
+            out_errorMessage = formatR(_("Mesh file \"{0}\" cannot be loaded."), filename);
+            return nullptr;
+        }
+
+        vector<Vector3> vertices;
+        vector<int> triangles;
+        MeshExtractor extractor;
+        extractor.extract(scene, [&](){
+            SgMesh* mesh = extractor.currentMesh();
+            if(!mesh->hasVertices()) {
+                return;
+            }
+            const Affine3& T = extractor.currentTransform();
+            const int offset = vertices.size();
+            for(auto& v : *mesh->vertices()) {
+                vertices.push_back(T * v.cast<double>());
+            }
+            const SgIndexArray& indices = mesh->triangleVertices();
+            for(auto& i : indices) {
+                triangles.push_back(offset + i);
+            }
+        });
+        if(triangles.empty()) {
+            out_errorMessage = formatR(_("Mesh file \"{0}\" has no triangles."), filename);
+            return nullptr;
+        }
+
+        field = const_pointer_cast<SignedDistanceField>(build(vertices, triangles, voxelSize));
+        if(!cachePath.empty()) {
+            // the field is still usable when the cache cannot be written
+            try {
+                filesystem::create_directories(cachePath.parent_path());
+                field->save(cachePath.string(), path, fileSize, fileTime);
+            }
+            catch(const std::exception&) {
+
+            }
+        }
+    }
+
+    RegistryEntry& entry = registry[key];
+    entry.field = field;
+    entry.fileSize = fileSize;
+    entry.fileTime = fileTime;
+    return field;
+}
+
+
+SignedDistanceFieldPtr SignedDistanceField::build
+(const vector<Vector3>& vertices, const vector<int>& triangles, double voxelSize)
+{
+    shared_ptr<SignedDistanceField> field(new SignedDistanceField);
+    Impl* impl = field->impl;
+    impl->voxelSize = voxelSize;
+    impl->vertices = vertices;
+    impl->triangles = triangles;
+    impl->initializeGrid();
+    impl->voxelize();
+    impl->extractSurfacePoints();
+    return field;
+}
+
+
+void SignedDistanceField::Impl::initializeGrid()
+{
+    bandWidth = BandVoxels * voxelSize;
+    if(vertices.empty()) {
+        min.setZero();
+        max.setZero();
+    } else {
+        min = max = vertices[0];
+        for(auto& v : vertices) {
+            min = min.cwiseMin(v);
+            max = max.cwiseMax(v);
+        }
+    }
+
+    // the outermost grid points are beyond the band so that the field is closed
+    const double margin = bandWidth + voxelSize;
+    origin = min - Vector3::Constant(margin);
+    const Vector3 extent = (max - min) / voxelSize + Vector3::Constant(2.0 * margin / voxelSize);
+    nx = (int)ceil(extent.x()) + 1;
+    ny = (int)ceil(extent.y()) + 1;
+    nz = (int)ceil(extent.z()) + 1;
+
+    // the bricks cover the nx - 1 cells along x
+    bx = (nx - 2) / BrickSize + 1;
+    by = (ny - 2) / BrickSize + 1;
+    bz = (nz - 2) / BrickSize + 1;
+}
+
+
+void SignedDistanceField::Impl::voxelize()
+{
+    // the bricks within the band of a triangle are allocated first
+    brickTable.assign((size_t)bx * by * bz, OutsideBrick);
+    forEachSlab([this](int bkBegin, int bkEnd){ markBricks(bkBegin, bkEnd); });
+
+    int32_t numBricks = 0;
+    for(auto& brick : brickTable) {
+        if(brick == MarkedBrick) {
+            brick = numBricks++;
+        }
+    }
+    values.assign((size_t)numBricks * BrickVolume, (float)bandWidth);
+
+    forEachSlab([this](int bkBegin, int bkEnd){ voxelizeSlab(bkBegin, bkEnd); });
+}
+
+
+// Each thread owns a slab of the brick layers along z, so no brick is written by two threads
+template<class Function>
+void SignedDistanceField::Impl::forEachSlab(const Function& func)
+{
+    int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, bz);
+    vector<std::thread> threads;
+    for(int t = 1; t < numThreads; ++t) {
+        threads.emplace_back([&func, this, t, numThreads](){
+            func(bz * t / numThreads, bz * (t + 1) / numThreads);
+        });
+    }
+    func(0, bz / numThreads);
+    for(auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+void SignedDistanceField::Impl::markBricks(int bkBegin, int bkEnd)
+{
+    const double h = voxelSize;
+    // a brick is in the band of a triangle when its center is near enough to the triangle
+    const double reach = bandWidth + 0.5 * sqrt(3.0) * BrickSize * h;
+
+    const int numTriangles = triangles.size() / 3;
+    for(int t = 0; t < numTriangles; ++t) {
+        const Vector3& a = vertices[triangles[t * 3]];
+        const Vector3& b = vertices[triangles[t * 3 + 1]];
+        const Vector3& c = vertices[triangles[t * 3 + 2]];
+        const Vector3 lower = (a.cwiseMin(b).cwiseMin(c) - origin - Vector3::Constant(bandWidth)) / h;
+        const Vector3 upper = (a.cwiseMax(b).cwiseMax(c) - origin + Vector3::Constant(bandWidth)) / h;
+        int bi0, bi1, bj0, bj1, bk0, bk1;
+        getBrickRange(std::max(0, (int)ceil(lower.x())), std::min(nx - 1, (int)floor(upper.x())), bx, bi0, bi1);
+        getBrickRange(std::max(0, (int)ceil(lower.y())), std::min(ny - 1, (int)floor(upper.y())), by, bj0, bj1);
+        getBrickRange(std::max(0, (int)ceil(lower.z())), std::min(nz - 1, (int)floor(upper.z())), bz, bk0, bk1);
+        bk0 = std::max(bk0, bkBegin);
+        bk1 = std::min(bk1, bkEnd);
+        for(int bk = bk0; bk < bk1; ++bk) {
+            for(int bj = bj0; bj < bj1; ++bj) {
+                for(int bi = bi0; bi < bi1; ++bi) {
+                    int32_t& brick = brickTable[brickIndex(bi, bj, bk)];
+                    if(brick == MarkedBrick) {
+                        continue;
+                    }
+                    const Vector3 p = origin + (Vector3(bi, bj, bk) * BrickSize + Vector3::Constant(0.5 * BrickSize)) * h;
+                    if((p - closestPointOnTriangle(p, a, b, c)).norm() <= reach) {
+                        brick = MarkedBrick;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void SignedDistanceField::Impl::voxelizeSlab(int bkBegin, int bkEnd)
+{
+    const double h = voxelSize;
+    // the rays for the inside test run slightly off the grid to avoid hitting the edges
+    const double ey = 1.234567e-5 * h;
+    const double ez = 2.345678e-5 * h;
+    // the grid points of the slab including the layer shared with the next slab
+    const int kBegin = bkBegin * BrickSize;
+    const int kEnd = std::min(nz, bkEnd * BrickSize + 1);
+    vector<vector<double>> crossings((size_t)(kEnd - kBegin) * ny);
+
+    const int numTriangles = triangles.size() / 3;
+    for(int t = 0; t < numTriangles; ++t) {
+        const Vector3& a = vertices[triangles[t * 3]];
+        const Vector3& b = vertices[triangles[t * 3 + 1]];
+        const Vector3& c = vertices[triangles[t * 3 + 2]];
+        const Vector3 tmin = a.cwiseMin(b).cwiseMin(c);
+        const Vector3 tmax = a.cwiseMax(b).cwiseMax(c);
+
+        // unsigned distances of the grid points of the allocated bricks in the band
+        const Vector3 lower = (tmin - origin - Vector3::Constant(bandWidth)) / h;
+        const Vector3 upper = (tmax - origin + Vector3::Constant(bandWidth)) / h;
+        const int i0 = std::max(0, (int)ceil(lower.x()));
+        const int i1 = std::min(nx - 1, (int)floor(upper.x()));
+        const int j0 = std::max(0, (int)ceil(lower.y()));
+        const int j1 = std::min(ny - 1, (int)floor(upper.y()));
+        const int k0 = std::max(kBegin, (int)ceil(lower.z()));
+        const int k1 = std::min(kEnd - 1, (int)floor(upper.z()));
+        if(i0 <= i1 && j0 <= j1 && k0 <= k1) {
+            int bi0, bi1, bj0, bj1, bk0, bk1;
+            getBrickRange(i0, i1, bx, bi0, bi1);
+            getBrickRange(j0, j1, by, bj0, bj1);
+            getBrickRange(k0, k1, bz, bk0, bk1);
+            bk0 = std::max(bk0, bkBegin);
+            bk1 = std::min(bk1, bkEnd);
+            for(int bk = bk0; bk < bk1; ++bk) {
+                for(int bj = bj0; bj < bj1; ++bj) {
+                    for(int bi = bi0; bi < bi1; ++bi) {
+                        const int32_t brick = brickTable[brickIndex(bi, bj, bk)];
+                        if(brick < 0) {
+                            continue;
+                        }
+                        float* brickValues = this->brickValues(brick);
+                        const int oi = bi * BrickSize;
+                        const int oj = bj * BrickSize;
+                        const int ok = bk * BrickSize;
+                        for(int k = std::max(k0, ok); k <= std::min(k1, ok + BrickSize); ++k) {
+                            for(int j = std::max(j0, oj); j <= std::min(j1, oj + BrickSize); ++j) {
+                                for(int i = std::max(i0, oi); i <= std::min(i1, oi + BrickSize); ++i) {
+                                    const Vector3 p = origin + Vector3(i, j, k) * h;
+                                    const float d = (p - closestPointOnTriangle(p, a, b, c)).norm();
+                                    float& value = brickValues[pointIndex(i - oi, j - oj, k - ok)];
+                                    if(d < value) {
+                                        value = d;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // crossings of the rays along the x axis
+        const double det = (b.y() - a.y()) * (c.z() - a.z()) - (c.y() - a.y()) * (b.z() - a.z());
+        if(det == 0.0) {
+            continue;
+        }
+        const int rj0 = std::max(0, (int)ceil((tmin.y() - origin.y() - ey) / h));
+        const int rj1 = std::min(ny - 1, (int)floor((tmax.y() - origin.y() - ey) / h));
+        const int rk0 = std::max(kBegin, (int)ceil((tmin.z() - origin.z() - ez) / h));
+        const int rk1 = std::min(kEnd - 1, (int)floor((tmax.z() - origin.z() - ez) / h));
+        for(int k = rk0; k <= rk1; ++k) {
+            const double z = origin.z() + k * h + ez - a.z();
+            for(int j = rj0; j <= rj1; ++j) {
+                const double y = origin.y() + j * h + ey - a.y();
+                const double s = (y * (c.z() - a.z()) - (c.y() - a.y()) * z) / det;
+                const double u = ((b.y() - a.y()) * z - y * (b.z() - a.z())) / det;
+                if(s >= 0.0 && u >= 0.0 && s + u <= 1.0) {
+                    const double x = a.x() + s * (b.x() - a.x()) + u * (c.x() - a.x());
+                    crossings[(size_t)(k - kBegin) * ny + j].push_back(x);
+                }
+            }
+        }
+    }
+    for(auto& xs : crossings) {
+        std::sort(xs.begin(), xs.end());
+    }
+
+    // a grid point is inside when the ray from -x has crossed the surface an odd number of times
+    auto isInside = [&](int i, int j, int k){
+        const vector<double>& xs = crossings[(size_t)(k - kBegin) * ny + j];
+        const double x = origin.x() + i * h;
+        return (std::lower_bound(xs.begin(), xs.end(), x) - xs.begin()) % 2 == 1;
+    };
+    for(int bk = bkBegin; bk < bkEnd; ++bk) {
+        for(int bj = 0; bj < by; ++bj) {
+            for(int bi = 0; bi < bx; ++bi) {
+                int32_t& brick = brickTable[brickIndex(bi, bj, bk)];
+                const int oi = bi * BrickSize;
+                const int oj = bj * BrickSize;
+                const int ok = bk * BrickSize;
+                if(brick < 0) {
+                    // the brick apart from the surface is entirely inside or outside
+                    if(isInside(oi, oj, ok)) {
+                        brick = InsideBrick;
+                    }
+                    continue;
+                }
+                float* brickValues = this->brickValues(brick);
+                for(int k = ok; k <= std::min(nz - 1, ok + BrickSize); ++k) {
+                    for(int j = oj; j <= std::min(ny - 1, oj + BrickSize); ++j) {
+                        const vector<double>& xs = crossings[(size_t)(k - kBegin) * ny + j];
+                        if(xs.empty()) {
+                            continue;
+                        }
+                        size_t numCrossed = 0;
+                        for(int i = oi; i <= std::min(nx - 1, oi + BrickSize); ++i) {
+                            const double x = origin.x() + i * h;
+                            while(numCrossed < xs.size() && xs[numCrossed] < x) {
+                                ++numCrossed;
+                            }
+                            if(numCrossed % 2 == 1) {
+                                float& value = brickValues[pointIndex(i - oi, j - oj, k - ok)];
+                                value = -value;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void SignedDistanceField::Impl::extractSurfacePoints()
+{
+    surfacePoints.clear();
+    const double threshold = 0.5 * sqrt(3.0) * voxelSize;
+    for(int bk = 0; bk < bz; ++bk) {
+        for(int bj = 0; bj < by; ++bj) {
+            for(int bi = 0; bi < bx; ++bi) {
+                const int32_t brick = brickTable[brickIndex(bi, bj, bk)];
+                if(brick < 0) {
+                    continue;
+                }
+                // the points shared with the next bricks are taken from those bricks
+                const float* brickValues = this->brickValues(brick);
+                const int oi = bi * BrickSize;
+                const int oj = bj * BrickSize;
+                const int ok = bk * BrickSize;
+                for(int k = ok; k < std::min(nz, ok + BrickSize); ++k) {
+                    for(int j = oj; j < std::min(ny, oj + BrickSize); ++j) {
+                        for(int i = oi; i < std::min(nx, oi + BrickSize); ++i) {
+                            if(fabs(brickValues[pointIndex(i - oi, j - oj, k - ok)]) <= threshold) {
+                                surfacePoints.push_back(origin + Vector3(i, j, k) * voxelSize);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+double SignedDistanceField::voxelSize() const
+{
+    return impl->voxelSize;
+}
+
+
+double SignedDistanceField::bandWidth() const
+{
+    return impl->bandWidth;
+}
+
+
+const Vector3& SignedDistanceField::min() const
+{
+    return impl->min;
+}
+
+
+const Vector3& SignedDistanceField::max() const
+{
+    return impl->max;
+}
+
+
+const vector<Vector3>& SignedDistanceField::vertices() const
+{
+    return impl->vertices;
+}
+
+
+const vector<int>& SignedDistanceField::triangles() const
+{
+    return impl->triangles;
+}
+
+
+const vector<Vector3>& SignedDistanceField::surfacePoints() const
+{
+    return impl->surfacePoints;
+}
+
+
+size_t SignedDistanceField::numBricks() const
+{
+    return impl->values.size() / BrickVolume;
+}
+
+
+size_t SignedDistanceField::memorySize() const
+{
+    return sizeof(int32_t) * impl->brickTable.size() + sizeof(float) * impl->values.size();
+}
+
+
+double SignedDistanceField::distance(const Vector3& point) const
+{
+    const Vector3 g = (point - impl->origin) / impl->voxelSize;
+    const Vector3 upper(impl->nx - 1, impl->ny - 1, impl->nz - 1);
+    const Vector3 c = g.cwiseMax(0.0).cwiseMin(upper);
+    if(c != g) {
+        return impl->bandWidth + (g - c).norm() * impl->voxelSize;
+    }
+
+    const int i = std::min((int)c.x(), impl->nx - 2);
+    const int j = std::min((int)c.y(), impl->ny - 2);
+    const int k = std::min((int)c.z(), impl->nz - 2);
+    const int32_t brick = impl->brickTable[impl->brickIndex(i / BrickSize, j / BrickSize, k / BrickSize)];
+    if(brick < 0) {
+        return brick == InsideBrick ? -impl->bandWidth : impl->bandWidth;
+    }
+
+    const double fx = c.x() - i;
+    const double fy = c.y() - j;
+    const double fz = c.z() - k;
+    const float* v = impl->brickValues(brick) + Impl::pointIndex(i % BrickSize, j % BrickSize, k % BrickSize);
+    const int sy = BrickPoints;
+    const int sz = BrickPoints * BrickPoints;
+
+    const double v00 = v[0] + fx * (v[1] - v[0]);
+    const double v10 = v[sy] + fx * (v[sy + 1] - v[sy]);
+    const double v01 = v[sz] + fx * (v[sz + 1] - v[sz]);
+    const double v11 = v[sz + sy] + fx * (v[sz + sy + 1] - v[sz + sy]);
+    const double v0 = v00 + fy * (v10 - v00);
+    const double v1 = v01 + fy * (v11 - v01);
+    return v0 + fz * (v1 - v0);
+}
+
+
+bool SignedDistanceField::save
+(const string& filename, const string& meshFile, int64_t fileSize, int64_t fileTime) const
+{
+    std::ofstream ofs(filename, ios::binary | ios::trunc);
+    if(!ofs) {
+        return false;
+    }
+    ofs.write(FileMagic, sizeof(FileMagic));
+    writeValue(ofs, FileVersion);
+    writeValue(ofs, (uint32_t)meshFile.size());
+    ofs.write(meshFile.data(), meshFile.size());
+    writeValue(ofs, fileSize);
+    writeValue(ofs, fileTime);
+    writeValue(ofs, impl->voxelSize);
+    writeValue(ofs, (uint32_t)impl->nx);
+    writeValue(ofs, (uint32_t)impl->ny);
+    writeValue(ofs, (uint32_t)impl->nz);
+    ofs.write(reinterpret_cast<const char*>(impl->origin.data()), sizeof(double) * 3);
+    ofs.write(reinterpret_cast<const char*>(impl->brickTable.data()), sizeof(int32_t) * impl->brickTable.size());
+    writeValue(ofs, (uint32_t)numBricks());
+    ofs.write(reinterpret_cast<const char*>(impl->values.data()), sizeof(float) * impl->values.size());
+    writeValue(ofs, (uint32_t)impl->vertices.size());
+    ofs.write(reinterpret_cast<const char*>(impl->vertices.data()), sizeof(Vector3) * impl->vertices.size());
+    writeValue(ofs, (uint32_t)impl->triangles.size());
+    ofs.write(reinterpret_cast<const char*>(impl->triangles.data()), sizeof(int) * impl->triangles.size());
+    return static_cast<bool>(ofs);
+}
+
+
+bool SignedDistanceField::Impl::read
+(const string& filename, const string& meshFile, int64_t fileSize, int64_t fileTime, double voxelSize)
+{
+    std::ifstream ifs(filename, ios::binary);
+    if(!ifs) {
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t pathLength = 0;
+    int64_t size = 0;
+    int64_t time = 0;
+    double h = 0.0;
+    uint32_t n[3] = { 0, 0, 0 };
+    ifs.read(magic, sizeof(magic));
+    if(!ifs || memcmp(magic, FileMagic, sizeof(magic)) != 0
+       || !readValue(ifs, version) || version != FileVersion
+       || !readValue(ifs, pathLength) || pathLength != meshFile.size()) {
+        return false;
+    }
+    string path(pathLength, '\0');
+    ifs.read(&path[0], pathLength);
+    if(!ifs || path != meshFile
+       || !readValue(ifs, size) || size != fileSize
+       || !readValue(ifs, time) || time != fileTime
+       || !readValue(ifs, h) || h != voxelSize
+       || !readValue(ifs, n[0]) || !readValue(ifs, n[1]) || !readValue(ifs, n[2])) {
+        return false;
+    }
+    if(n[0] < 2 || n[1] < 2 || n[2] < 2) {
+        return false;
+    }
+
+    this->voxelSize = voxelSize;
+    nx = n[0];
+    ny = n[1];
+    nz = n[2];
+    ifs.read(reinterpret_cast<char*>(origin.data()), sizeof(double) * 3);
+    const size_t numEntries = (size_t)((nx - 2) / BrickSize + 1) * ((ny - 2) / BrickSize + 1) * ((nz - 2) / BrickSize + 1);
+    brickTable.resize(numEntries);
+    ifs.read(reinterpret_cast<char*>(brickTable.data()), sizeof(int32_t) * numEntries);
+    uint32_t numBricks = 0;
+    if(!readValue(ifs, numBricks)) {
+        return false;
+    }
+    for(auto& brick : brickTable) {
+        if(brick < InsideBrick || brick >= (int64_t)numBricks) {
+            return false;
+        }
+    }
+    values.resize((size_t)numBricks * BrickVolume);
+    ifs.read(reinterpret_cast<char*>(values.data()), sizeof(float) * values.size());
+    uint32_t numVertices = 0;
+    if(!readValue(ifs, numVertices)) {
+        return false;
+    }
+    vertices.resize(numVertices);
+    ifs.read(reinterpret_cast<char*>(vertices.data()), sizeof(Vector3) * numVertices);
+    uint32_t numIndices = 0;
+    if(!readValue(ifs, numIndices)) {
+        return false;
+    }
+    triangles.resize(numIndices);
+    ifs.read(reinterpret_cast<char*>(triangles.data()), sizeof(int) * numIndices);
+    if(!ifs) {
+        return false;
+    }
+
+    // the bounds and the grid derived from the stored mesh must agree with the stored grid
+    Vector3 storedOrigin = origin;
+    initializeGrid();
+    if(nx != (int)n[0] || ny != (int)n[1] || nz != (int)n[2] || !origin.isApprox(storedOrigin)) {
+        return false;
+    }
+    extractSurfacePoints();
+    return true;
+}
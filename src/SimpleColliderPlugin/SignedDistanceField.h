@@ -0,0 +1,101 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_SIMPLECOLLIDER_PLUGIN_SIGNED_DISTANCE_FIELD_H
+#define CNOID_SIMPLECOLLIDER_PLUGIN_SIGNED_DISTANCE_FIELD_H
+
+#include <cnoid/EigenTypes>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Narrow-band signed distance field of a closed triangle mesh, negative inside.
+
+   The distances are exact within a band of a few voxels around the surface
+   and clamped to the band width elsewhere, which keeps the sign for any point
+   while the voxelization only visits the voxels near the triangles. A point
+   query is a trilinear lookup whose cost does not depend on the mesh.
+
+   The grid is stored as a sparse brick map. Only the bricks of 8^3 voxels
+   crossed by the band hold their distances, so the memory grows with the area
+   of the surface. The other bricks are marked inside or outside in a table
+   that takes 4 bytes per brick.
+
+   The field of a mesh file is cached in "~/.cache/choreonoid/sdf", named by a
+   hash of the path of the mesh and the voxel size. The cache file consists of
+   the following little-endian data.
+
+   - char[8]    magic "CNOIDSDF"
+   - uint32     version (2)
+   - uint32     length of the path followed by the path of the mesh file
+   - int64      size of the mesh file
+   - int64      modification time of the mesh file
+   - float64    voxel size
+   - uint32     nx, ny, nz of the grid points
+   - float64[3] origin
+   - int32      brick table of bz * by * bx entries with x varying fastest,
+                the index of the brick or -1 for outside and -2 for inside
+   - uint32     number of bricks followed by 9^3 float32 distances per brick
+                with x varying fastest, including the points shared with the next bricks
+   - uint32     number of vertices followed by float64[3] per vertex
+   - uint32     number of triangle indices followed by int32 per index
+
+   The cache is used only while the path, the size and the time of the mesh file match.
+*/
+class CNOID_EXPORT SignedDistanceField
+{
+public:
+    // Returns the field of the mesh file, sharing it with the other users of the file
+    static std::shared_ptr<const SignedDistanceField> load(
+        const std::string& filename, double voxelSize, std::string& out_errorMessage);
+
+    /**
+       Voxelizes the mesh in parallel.
+       @param triangles three vertex indices per triangle
+    */
+    static std::shared_ptr<const SignedDistanceField> build(
+        const std::vector<Vector3>& vertices, const std::vector<int>& triangles, double voxelSize);
+
+    ~SignedDistanceField();
+
+    double voxelSize() const;
+    double bandWidth() const;
+
+    // Bounds of the mesh
+    const Vector3& min() const;
+    const Vector3& max() const;
+
+    const std::vector<Vector3>& vertices() const;
+    const std::vector<int>& triangles() const;
+
+    // The grid points within half a voxel diagonal from the surface
+    const std::vector<Vector3>& surfacePoints() const;
+
+    // Points farther than the band width are given the band width with the sign
+    double distance(const Vector3& point) const;
+    bool contains(const Vector3& point) const { return distance(point) <= 0.0; }
+
+    // The bricks holding the distances and the bytes of the brick map
+    size_t numBricks() const;
+    size_t memorySize() const;
+
+    bool save(const std::string& filename, const std::string& meshFile, int64_t fileSize, int64_t fileTime) const;
+
+private:
+    SignedDistanceField();
+
+    class Impl;
+    Impl* impl;
+};
+
+typedef std::shared_ptr<const SignedDistanceField> SignedDistanceFieldPtr;
+
+}
+
+#endif // CNOID_SIMPLECOLLIDER_PLUGIN_SIGNED_DISTANCE_FIELD_H
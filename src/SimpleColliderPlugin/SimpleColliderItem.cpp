@@ -18,8 +18,10 @@
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
 #include <cnoid/ConnectionSet>
+#include <cnoid/LazyCaller>
 #include <cnoid/MathUtil>
 #include <cnoid/Format>
+#include "CompiledCollider.h"
 #include "gettext.h"
 
 using namespace std;
@@ -29,12 +31,8 @@ namespace {
 
 Signal<void()> sigItemsInProjectChanged_;
 
-void notSupportText()
-{
-    // mvout()
-    //     << formatR(_("This combination is not supported."))
-    //     << endl;
-}
+int bulkEditDepth = 0;
+vector<SimpleColliderItemPtr> bulkEditedItems;
 
 class SceneLocation : public LocationProxy
 {
@@ -64,6 +62,13 @@ public:
     void updateScenePosition();
     void updateSceneShape();
     void updateSceneMaterial();
+    void requestSceneShapeUpdate();
+    void requestSceneMaterialUpdate();
+    void requestSceneUpdate();
+    void flushSceneUpdate();
+    void notifyShapeChange() { ++shapeRevision; self->onShapeChanged(); }
+    bool loadMesh();
+    void requestMeshLoad();
 
     bool loadSimpleCollider(const string& filename, ostream& os);
     bool saveSimpleCollider(const string& filename, ostream& os);
@@ -75,15 +80,24 @@ public:
     Selection sceneTypeSelection;
     SgShapePtr sceneShape;
     SgMaterialPtr sceneMaterial;
+    LazyCaller updateSceneLater;
+    bool isSceneShapeDirty;
+    bool isSceneMaterialDirty;
+    bool isDistanceFieldDirty;
+    bool isBulkEdited;
     Vector3 size_;
     double radius_;
     double height_;
+    string meshFile_;
+    double voxelSize_;
+    SignedDistanceFieldPtr distanceField;
     Vector3 diffuseColor_;
     double specularExponent_;
     double transparency_;
     ScopedConnectionSet connections;
     ref_ptr<SceneLocation> sceneLocation;
     MappingPtr info;
+    unsigned int shapeRevision;
 };
 
 }
@@ -113,7 +127,8 @@ SimpleColliderItem::SimpleColliderItem()
 
 
 SimpleColliderItem::Impl::Impl(SimpleColliderItem* self)
-    : self(self)
+    : self(self),
+      updateSceneLater([this](){ flushSceneUpdate(); })
 {
     bodyItem = nullptr;
     worldItem = nullptr;
@@ -121,14 +136,21 @@ SimpleColliderItem::Impl::Impl(SimpleColliderItem* self)
     sceneTypeSelection.setSymbol(BOX, N_("Box"));
     sceneTypeSelection.setSymbol(CYLINDER, N_("Cylinder"));
     sceneTypeSelection.setSymbol(SPHERE, N_("Sphere"));
+    sceneTypeSelection.setSymbol(MESH, N_("Mesh"));
     sceneTypeSelection.select(BOX);
     size_ << 1.0, 1.0, 1.0;
     radius_ = 0.5;
     height_ = 1.0;
+    voxelSize_ = 0.02;
     diffuseColor_ << 0.5, 0.5, 0.5;
     specularExponent_ = 25.0f;
     transparency_ = 0.8;
     info = new Mapping;
+    shapeRevision = 0;
+    isSceneShapeDirty = false;
+    isSceneMaterialDirty = false;
+    isDistanceFieldDirty = false;
+    isBulkEdited = false;
 }
 
 
@@ -140,7 +162,8 @@ SimpleColliderItem::SimpleColliderItem(const SimpleColliderItem& org)
 
 
 SimpleColliderItem::Impl::Impl(SimpleColliderItem* self, const Impl& org)
-    : self(self)
+    : self(self),
+      updateSceneLater([this](){ flushSceneUpdate(); })
 {
     bodyItem = nullptr;
     worldItem = nullptr;
@@ -149,10 +172,21 @@ SimpleColliderItem::Impl::Impl(SimpleColliderItem* self, const Impl& org)
     size_ = org.size_;
     radius_ = org.radius_;
     height_ = org.height_;
+    meshFile_ = org.meshFile_;
+    voxelSize_ = org.voxelSize_;
+    distanceField = org.distanceField;
     diffuseColor_ = org.diffuseColor_;
     specularExponent_ = org.specularExponent_;
     transparency_ = org.transparency_;
     info = org.info;
+    shapeRevision = 0;
+    isSceneShapeDirty = false;
+    isSceneMaterialDirty = false;
+    isDistanceFieldDirty = false;
+    isBulkEdited = false;
+    if(org.isDistanceFieldDirty) {
+        requestMeshLoad();
+    }
 }
 
 
@@ -166,6 +200,7 @@ void SimpleColliderItem::storeBodyPosition()
 {
     if(impl->bodyItem) {
         impl->position_ = impl->bodyItem->body()->rootLink()->position();
+        impl->notifyShapeChange();
         impl->updateScenePosition();
         notifyUpdate();
         // mvout()
@@ -193,6 +228,8 @@ SgNode* SimpleColliderItem::getScene()
 {
     if(!impl->scene) {
         impl->createScene();
+    } else {
+        impl->flushSceneUpdate();
     }
     return impl->scene;
 }
@@ -201,6 +238,7 @@ SgNode* SimpleColliderItem::getScene()
 void SimpleColliderItem::setPosition(const Isometry3& T)
 {
     impl->position_ = T;
+    impl->notifyShapeChange();
     impl->updateScenePosition();
     notifyUpdate();
     if(impl->sceneLocation) {
@@ -217,10 +255,16 @@ const Isometry3& SimpleColliderItem::position() const
 
 bool SimpleColliderItem::setSceneType(int sceneId)
 {
+    const bool isChanged = sceneId != impl->sceneTypeSelection.which();
     if(!impl->sceneTypeSelection.select(sceneId)) {
         return false;
     }
-    impl->updateSceneShape();
+    if(isChanged) {
+        // only a mesh collider holds the distance field
+        impl->loadMesh();
+    }
+    impl->notifyShapeChange();
+    impl->requestSceneShapeUpdate();
     notifyUpdate();
     return true;
 }
@@ -235,7 +279,8 @@ double SimpleColliderItem::sceneType() const
 void SimpleColliderItem::setSize(const Vector3& size)
 {
     impl->size_ = size;
-    impl->updateSceneShape();
+    impl->notifyShapeChange();
+    impl->requestSceneShapeUpdate();
 }
 
 
@@ -248,7 +293,8 @@ const Vector3& SimpleColliderItem::size() const
 void SimpleColliderItem::setRadius(const double& radius)
 {
     impl->radius_ = radius;
-    impl->updateSceneShape();
+    impl->notifyShapeChange();
+    impl->requestSceneShapeUpdate();
 }
 
 
@@ -261,7 +307,8 @@ const double& SimpleColliderItem::radius() const
 void SimpleColliderItem::setHeight(const double& height)
 {
     impl->height_ = height;
-    impl->updateSceneShape();
+    impl->notifyShapeChange();
+    impl->requestSceneShapeUpdate();
 }
 
 
@@ -271,17 +318,137 @@ const double& SimpleColliderItem::height() const
 }
 
 
+bool SimpleColliderItem::setMeshFile(const string& filename)
+{
+    impl->meshFile_ = filename;
+    bool loaded = impl->loadMesh();
+    impl->notifyShapeChange();
+    impl->requestSceneShapeUpdate();
+    return loaded || impl->sceneTypeSelection.which() != MESH;
+}
+
+
+const string& SimpleColliderItem::meshFile() const
+{
+    return impl->meshFile_;
+}
+
+
+bool SimpleColliderItem::setVoxelSize(double voxelSize)
+{
+    if(!(voxelSize > 0.0)) {
+        return false;
+    }
+    impl->voxelSize_ = voxelSize;
+    impl->requestMeshLoad();
+    return true;
+}
+
+
+double SimpleColliderItem::voxelSize() const
+{
+    return impl->voxelSize_;
+}
+
+
+SignedDistanceFieldPtr SimpleColliderItem::signedDistanceField() const
+{
+    return impl->distanceField;
+}
+
+
+bool SimpleColliderItem::Impl::loadMesh()
+{
+    distanceField.reset();
+    isDistanceFieldDirty = false;
+    if(sceneTypeSelection.which() != MESH || meshFile_.empty()) {
+        return false;
+    }
+    string message;
+    distanceField = SignedDistanceField::load(meshFile_, voxelSize_, message);
+    if(!distanceField) {
+        mvout() << message << endl;
+        return false;
+    }
+    return true;
+}
+
+
+// The successive edits of the voxel size are voxelized once at the next event loop
+void SimpleColliderItem::Impl::requestMeshLoad()
+{
+    if(sceneTypeSelection.which() == MESH && !meshFile_.empty()) {
+        isDistanceFieldDirty = true;
+        requestSceneShapeUpdate();
+    }
+}
+
+
 void SimpleColliderItem::setDiffuseColor(const Vector3& diffuseColor)
 {
     impl->diffuseColor_ = diffuseColor;
-    impl->updateSceneMaterial();
+    impl->requestSceneMaterialUpdate();
 }
 
 
 void SimpleColliderItem::setTransparency(const double& transparency)
 {
     impl->transparency_ = transparency;
-    impl->updateSceneMaterial();
+    impl->requestSceneMaterialUpdate();
+}
+
+
+BoundingBox SimpleColliderItem::boundingBox() const
+{
+    const Vector3 p = impl->position_.translation();
+    const Matrix3 R = impl->position_.linear();
+
+    Vector3 e;
+    switch(impl->sceneTypeSelection.which()) {
+    case BOX:
+        e = R.cwiseAbs() * (impl->size_ / 2.0);
+        break;
+    case CYLINDER:
+    {
+        // the cylinder axis is the local Y axis
+        const Vector3 a = R.col(1);
+        const double h = impl->height_ / 2.0;
+        for(int i = 0; i < 3; ++i) {
+            e[i] = fabs(a[i]) * h + impl->radius_ * sqrt(std::max(0.0, 1.0 - a[i] * a[i]));
+        }
+        break;
+    }
+    case SPHERE:
+        e = Vector3::Constant(impl->radius_);
+        break;
+    case MESH:
+        if(impl->distanceField) {
+            // the mesh bounds are not centered at the origin of the collider
+            const Vector3 c = (impl->distanceField->max() + impl->distanceField->min()) / 2.0;
+            const Vector3 h = (impl->distanceField->max() - impl->distanceField->min()) / 2.0;
+            const Vector3 q = impl->position_ * c;
+            e = R.cwiseAbs() * h;
+            return BoundingBox(q - e, q + e);
+        }
+        e.setZero();
+        break;
+    default:
+        e.setZero();
+        break;
+    }
+    return BoundingBox(p - e, p + e);
+}
+
+
+unsigned int SimpleColliderItem::shapeRevision() const
+{
+    return impl->shapeRevision;
+}
+
+
+void SimpleColliderItem::onShapeChanged()
+{
+
 }
 
 
@@ -292,6 +459,26 @@ void SimpleColliderItem::notifyUpdate()
 }
 
 
+void SimpleColliderItem::beginBulkEdit()
+{
+    ++bulkEditDepth;
+}
+
+
+void SimpleColliderItem::endBulkEdit()
+{
+    if(bulkEditDepth == 0 || --bulkEditDepth > 0) {
+        return;
+    }
+    vector<SimpleColliderItemPtr> items;
+    items.swap(bulkEditedItems);
+    for(auto& item : items) {
+        item->impl->isBulkEdited = false;
+        item->impl->flushSceneUpdate();
+    }
+}
+
+
 SignalProxy<void()> SimpleColliderItem::sigItemsInProjectChanged()
 {
     return sigItemsInProjectChanged_;
@@ -372,6 +559,8 @@ void SimpleColliderItem::Impl::createScene()
         updateSceneShape();
         sceneMaterial = new SgMaterial;
         updateSceneMaterial();
+        isSceneShapeDirty = false;
+        isSceneMaterialDirty = false;
     } else {
         scene->clearChildren();
     }
@@ -411,6 +600,24 @@ void SimpleColliderItem::Impl::updateSceneShape()
         case SPHERE:
             sceneShape->setMesh(meshGenerator.generateSphere(radius_));
             break;
+        case MESH:
+        {
+            SgMeshPtr mesh = new SgMesh;
+            if(distanceField) {
+                SgVertexArray& vertices = *mesh->getOrCreateVertices();
+                for(auto& v : distanceField->vertices()) {
+                    vertices.push_back(v.cast<float>());
+                }
+                const vector<int>& triangles = distanceField->triangles();
+                for(size_t i = 0; i + 2 < triangles.size(); i += 3) {
+                    mesh->addTriangle(triangles[i], triangles[i + 1], triangles[i + 2]);
+                }
+                meshGenerator.generateNormals(mesh, 0.0);
+                mesh->updateBoundingBox();
+            }
+            sceneShape->setMesh(mesh);
+            break;
+        }
         default:
             break;
         }
@@ -419,6 +626,52 @@ void SimpleColliderItem::Impl::updateSceneShape()
 }
 
 
+void SimpleColliderItem::Impl::requestSceneShapeUpdate()
+{
+    isSceneShapeDirty = true;
+    requestSceneUpdate();
+}
+
+
+void SimpleColliderItem::Impl::requestSceneMaterialUpdate()
+{
+    isSceneMaterialDirty = true;
+    requestSceneUpdate();
+}
+
+
+void SimpleColliderItem::Impl::requestSceneUpdate()
+{
+    // the edits until the next event loop or the end of the bulk edit are applied at once
+    if(bulkEditDepth > 0) {
+        if(!isBulkEdited) {
+            isBulkEdited = true;
+            bulkEditedItems.push_back(self);
+        }
+    } else {
+        updateSceneLater();
+    }
+}
+
+
+void SimpleColliderItem::Impl::flushSceneUpdate()
+{
+    updateSceneLater.cancel();
+    if(isDistanceFieldDirty) {
+        loadMesh();
+        notifyShapeChange();
+    }
+    if(isSceneShapeDirty) {
+        isSceneShapeDirty = false;
+        updateSceneShape();
+    }
+    if(isSceneMaterialDirty) {
+        isSceneMaterialDirty = false;
+        updateSceneMaterial();
+    }
+}
+
+
 void SimpleColliderItem::Impl::updateSceneMaterial()
 {
     if(sceneMaterial) {
@@ -455,12 +708,15 @@ bool SimpleColliderItem::Impl::loadSimpleCollider(const string& filename, ostrea
     }
     archive->read("radius", radius_);
     archive->read("height", height_);
+    archive->read("voxel_size", voxelSize_);
+    archive->read("mesh_file", meshFile_);
     archive->read("specular_exponent", specularExponent_);
     archive->read("transparency", transparency_);
     string sceneId;
     if(archive->read("scene_type", sceneId)) {
         sceneTypeSelection.select(sceneId);
     }
+    loadMesh();
     return true;
 }
 
@@ -480,6 +736,10 @@ bool SimpleColliderItem::Impl::saveSimpleCollider(const string& filename, ostrea
     write(archive, "diffuse_color", Vector3(diffuseColor_));
     archive->write("radius", radius_);
     archive->write("height", height_);
+    archive->write("voxel_size", voxelSize_);
+    if(!meshFile_.empty()) {
+        archive->write("mesh_file", meshFile_);
+    }
     archive->write("specular_exponent", specularExponent_);
     archive->write("transparency", transparency_);
     archive->write("scene_type", sceneTypeSelection.selectedSymbol());
@@ -580,6 +840,17 @@ void SimpleColliderItem::doPutProperties(PutPropertyFunction& putProperty)
                         });
         }
         break;
+    case MESH:
+        putProperty(_("mesh file"), FilePathProperty(impl->meshFile_),
+                    [this](const string& filename) {
+                        setMeshFile(filename);
+                        return true;
+                    });
+        putProperty.min(0.001).max(10.0)(_("voxel size"), impl->voxelSize_,
+                    [this](double value) {
+                        return setVoxelSize(value);
+                    });
+        break;
     default:
         break;
     }
@@ -618,6 +889,10 @@ bool SimpleColliderItem::store(Archive& archive)
     write(archive, "diffuse_color", Vector3(impl->diffuseColor_));
     archive.write("radius", impl->radius_);
     archive.write("height", impl->height_);
+    archive.write("voxel_size", impl->voxelSize_);
+    if(!impl->meshFile_.empty()) {
+        archive.writeRelocatablePath("mesh_file", impl->meshFile_);
+    }
     archive.write("specular_exponent", impl->specularExponent_);
     archive.write("transparency", impl->transparency_);
     archive.write("scene_type", impl->sceneTypeSelection.selectedSymbol());
@@ -648,12 +923,19 @@ bool SimpleColliderItem::restore(const Archive& archive)
     }
     archive.read("radius", impl->radius_);
     archive.read("height", impl->height_);
+    archive.read("voxel_size", impl->voxelSize_);
+    string filename;
+    if(archive.read("mesh_file", filename)) {
+        impl->meshFile_ = archive.resolveRelocatablePath(filename);
+    }
     archive.read("specular_exponent", impl->specularExponent_);
     archive.read("transparency", impl->transparency_);
     string sceneId;
     if(archive.read("scene_type", sceneId)) {
         impl->sceneTypeSelection.select(sceneId);
     }
+    impl->loadMesh();
+    impl->notifyShapeChange();
     return true;
 
     // return archive.loadFileTo(this);
@@ -703,126 +985,13 @@ namespace cnoid {
 
 bool collision(SimpleColliderItem* colliderItem, const Vector3& point)
 {
-    auto p = colliderItem->position().translation();
-    auto R = colliderItem->position().linear();
-    auto size = colliderItem->size();
-    auto radius = colliderItem->radius();
-    auto height = colliderItem->height();
-
-    // box
-    Vector3 min = p - size / 2.0;
-    Vector3 max = p + size / 2.0;
-    Vector3 p2 = R.inverse() * (point - p) + p;
-
-    // cylinder
-    Vector3 a = R * (Vector3::UnitY() * height / 2.0) + p;
-    Vector3 b = R * (Vector3::UnitY() * height / 2.0 * -1.0) + p;
-    Vector3 c = a - b;
-    Vector3 d = point - b;
-    double c_dot_d = c.dot(d);
-
-    // sphere
-    Vector3 r = p - point;
-
-    int sceneId = colliderItem->sceneType();
-    switch(sceneId) {
-    case SimpleColliderItem::BOX:
-        if((min[0] <= p2[0]) && (p2[0] <= max[0])
-                && (min[1] <= p2[1]) && (p2[1] <= max[1])
-                && (min[2] <= p2[2]) && (p2[2] <= max[2])) {
-            return true;
-        }
-        break;
-    case SimpleColliderItem::CYLINDER:
-        if((0.0 < c_dot_d) && (c_dot_d < c.dot(c))) {
-            double l2 = d.dot(d) - d.dot(c) * d.dot(c) / c.dot(c);
-            double r2 = radius * radius;
-            if(l2 < r2) {
-                return true;
-            }
-        }
-        break;
-    case SimpleColliderItem::SPHERE:
-        if(r.norm() <= radius) {
-            return true;
-        }
-        break;
-    default:
-        break;
-    }
-    return false;
+    return CompiledCollider(colliderItem).contains(point);
 }
 
 
 bool collision(SimpleColliderItem* colliderItem1, SimpleColliderItem* colliderItem2)
 {
-    auto p1 = colliderItem1->position().translation();
-    auto p2 = colliderItem2->position().translation();
-    auto R1 = colliderItem1->position().linear();
-    auto R2 = colliderItem2->position().linear();
-    auto size1 = colliderItem1->size();
-    auto size2 = colliderItem2->size();
-    auto radius1 = colliderItem1->radius();
-    auto radius2 = colliderItem2->radius();
-    auto height1 = colliderItem1->height();
-    auto height2 = colliderItem2->height();
-
-    // box1 x box2
-
-    // box1 x cylinder2
-
-    // box1 x sphere2
-
-    // cylinder1 x box2
-
-    // cylinder1 x cylinder2
-
-    // cylinder1 x sphere2
-
-    // sphere1 x box2
-
-    // sphere1 x cylinder2
-
-    // sphere1 x sphere2
-
-    int sceneId1 = colliderItem1->sceneType();
-    int sceneId2 = colliderItem2->sceneType();
-
-    switch(sceneId1) {
-    case SimpleColliderItem::BOX:
-        if(sceneId2 == SimpleColliderItem::BOX) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::CYLINDER) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::SPHERE) {
-            notSupportText();
-        }
-        break;
-    case SimpleColliderItem::CYLINDER:
-        if(sceneId2 == SimpleColliderItem::BOX) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::CYLINDER) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::SPHERE) {
-            notSupportText();
-        }
-        break;
-    case SimpleColliderItem::SPHERE:
-        if(sceneId2 == SimpleColliderItem::BOX) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::CYLINDER) {
-            notSupportText();
-        } else if(sceneId2 == SimpleColliderItem::SPHERE) {
-            if((p1 - p2).norm() <= (radius1 + radius2)) {
-                return true;
-            }
-        }
-        break;
-    default:
-        break;
-    }
-
-    return false;
+    return CompiledCollider(colliderItem1).intersects(CompiledCollider(colliderItem2));
 }
 
 }
@@ -6,8 +6,10 @@
 #define CNOID_SIMPLECOLLIDER_PLUGIN_SIMPLE_COLLIDER_ITEM_H
 
 #include <cnoid/Item>
+#include <cnoid/BoundingBox>
 #include <cnoid/RenderableItem>
 #include <cnoid/LocatableItem>
+#include "SignedDistanceField.h"
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -27,7 +29,7 @@ public:
     virtual SgNode* getScene() override;
     void setPosition(const Isometry3& T);
     const Isometry3& position() const;
-    enum SceneId { BOX, CYLINDER, SPHERE };
+    enum SceneId { BOX, CYLINDER, SPHERE, MESH };
     bool setSceneType(int sceneId);
     double sceneType() const;
     void setSize(const Vector3& size);
@@ -36,11 +38,32 @@ public:
     const double& radius() const;
     void setHeight(const double& height);
     const double& height() const;
+    // The mesh of a MESH collider is voxelized into the distance field when the file is set
+    // or the type switches to MESH, and at the next event loop after the voxel size changes
+    bool setMeshFile(const std::string& filename);
+    const std::string& meshFile() const;
+    bool setVoxelSize(double voxelSize);
+    double voxelSize() const;
+    SignedDistanceFieldPtr signedDistanceField() const;
     void setDiffuseColor(const Vector3& diffuseColor);
     void setTransparency(const double& transparency);
 
+    // Axis-aligned bounding box of the collider volume in world coordinates
+    BoundingBox boundingBox() const;
+    // Incremented whenever the position or the shape of the collider changes
+    unsigned int shapeRevision() const;
+
     virtual void notifyUpdate() override;
 
+    /**
+       The scene of a collider is rebuilt once in the next event loop after its
+       parameters are edited. Between beginBulkEdit() and endBulkEdit(), the
+       rebuilds of all the edited colliders are held until endBulkEdit(), so that
+       scripts can set up a large collider set in one pass. The calls can be nested.
+    */
+    static void beginBulkEdit();
+    static void endBulkEdit();
+
     static SignalProxy<void()> sigItemsInProjectChanged();
 
     // LocatableItem function
@@ -65,6 +88,9 @@ protected:
     virtual void onConnectedToRoot() override;
     virtual void onDisconnectedFromRoot() override;
 
+    // Called after the position or the shape is changed by one of the setters
+    virtual void onShapeChanged();
+
 private:
     Impl* impl;
 };
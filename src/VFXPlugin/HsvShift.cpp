@@ -0,0 +1,295 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "HsvShift.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__)
+#define CNOID_VFX_HSV_SHIFT_VECTOR
+#define CNOID_VFX_ALWAYS_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define CNOID_VFX_HSV_SHIFT_DISPATCH
+#endif
+#else
+#define CNOID_VFX_ALWAYS_INLINE inline
+#endif
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int BlockSize = 32;
+
+struct Offsets
+{
+    double hue;
+    double saturation;
+    double value;
+};
+
+template<class Int> struct LaneTypes;
+
+template<> struct LaneTypes<int32_t>
+{
+    typedef float Float;
+    typedef double Double;
+};
+
+#ifdef CNOID_VFX_HSV_SHIFT_VECTOR
+
+/*
+   The lanes of 4 fill the SSE registers and those of 8 fill the AVX2 ones.
+   The vectors are only passed to the inlined functions, whose ABI does not matter.
+*/
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef int32_t Int4 __attribute__((vector_size(16)));
+typedef float Float4 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef int32_t Int8 __attribute__((vector_size(32)));
+typedef float Float8 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+
+template<> struct LaneTypes<Int4>
+{
+    typedef Float4 Float;
+    typedef Double4 Double;
+};
+
+template<> struct LaneTypes<Int8>
+{
+    typedef Float8 Float;
+    typedef Double8 Double;
+};
+
+template<class To, class From>
+CNOID_VFX_ALWAYS_INLINE To convert(const From& x) { return __builtin_convertvector(x, To); }
+
+typedef Int4 GenericLanes;
+
+#else
+
+template<class To, class From>
+inline To convert(const From& x) { return static_cast<To>(x); }
+
+typedef int32_t GenericLanes;
+
+#endif
+
+/*
+   Floor of n / d for 0 <= n and 0 < d with n + 2d < 2^31. The float quotient
+   is off by one at most, which the integer products correct.
+*/
+template<class Int>
+CNOID_VFX_ALWAYS_INLINE Int divide(const Int& n, const Int& d)
+{
+    typedef typename LaneTypes<Int>::Float Float;
+    Int q = convert<Int>(convert<Float>(n) / convert<Float>(d));
+    q = (q + 1) * d <= n ? q + 1 : q;
+    q = q * d > n ? q - 1 : q;
+    return q;
+}
+
+/*
+   The QColor conversions in integers. With the 16-bit components of QColor,
+   toHsv() gives
+     value      = max * 257
+     saturation = qRound(65535 * delta / max)
+     hue        = qRound(6000 * (sector + num / delta))
+   and toRgb() gives qRound(65535 * x) for x = v, v(1 - s), v(1 - s f) and
+   v(1 - s (1 - f)), where the 8-bit channels are the upper bytes. Every
+   rounding is then the floor of a quotient of integers, which differs from
+   the floating-point one of QColor only when the quotient is a tie. The
+   offsets are added in double as QColor's callers do. The code has no
+   branch so that it runs on the lanes of a vector as well as on a scalar.
+*/
+template<class Int>
+CNOID_VFX_ALWAYS_INLINE void shiftLanes(int32_t* red, int32_t* green, int32_t* blue, const Offsets& offsets)
+{
+    typedef typename LaneTypes<Int>::Double Double;
+
+    Int r, g, b;
+    memcpy(&r, red, sizeof(Int));
+    memcpy(&g, green, sizeof(Int));
+    memcpy(&b, blue, sizeof(Int));
+
+    const Int zero = {};
+    const Int one = zero + 1;
+    const Int max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+    const Int min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+    const Int delta = max - min;
+
+    // rgb to hsv; the hue of an achromatic color is -1
+    const Int num = r == max ? g - b : (g == max ? b - r : r - g);
+    const Int sector = r == max ? (num < zero ? zero + 6 : zero) : (g == max ? zero + 2 : zero + 4);
+    const Int deltaDivisor = delta > zero ? delta : one;
+    const Int hue = delta > zero ? divide(12000 * (sector * delta + num) + delta, 200 * deltaDivisor) : zero - 1;
+    const Int saturation = divide(131070 * delta + max, 2 * (max > zero ? max : one)) >> 8;
+
+    Int h = convert<Int>(convert<Double>(hue) + offsets.hue);
+    Int s = convert<Int>(convert<Double>(saturation) + offsets.saturation);
+    Int v = convert<Int>(convert<Double>(max) + offsets.value);
+    h = h > 359 ? h - 360 : h;
+    h = h < zero ? zero : h;
+    s = s > 255 ? zero + 255 : s;
+    s = s < zero ? zero : s;
+    v = v > 255 ? zero + 255 : v;
+    v = v < zero ? zero : v;
+
+    // hsv to rgb; QColor::fromHsv() gives an invalid color, which is black, for a hue over 359
+    const Int i = (h * 1093) >> 16; // h / 60 for h < 360
+    const Int f = h - i * 60;
+    const Int cv = v * 257;
+    const Int cp = divide(514 * v * (255 - s) + 255, zero + 510);
+    const Int cq = divide(514 * v * (15300 - s * f) + 15300, zero + 30600);
+    const Int ct = divide(514 * v * (15300 - s * (60 - f)) + 15300, zero + 30600);
+
+    Int cr = ((i == 0) | (i == 5)) ? cv : (i == 1 ? cq : (i == 4 ? ct : cp));
+    Int cg = i == 0 ? ct : (((i == 1) | (i == 2)) ? cv : (i == 3 ? cq : cp));
+    Int cb = ((i == 0) | (i == 1)) ? cp : (i == 2 ? ct : (i == 5 ? cq : cv));
+    cr = s == 0 ? cv : cr;
+    cg = s == 0 ? cv : cg;
+    cb = s == 0 ? cv : cb;
+
+    r = h > 359 ? zero : cr >> 8;
+    g = h > 359 ? zero : cg >> 8;
+    b = h > 359 ? zero : cb >> 8;
+
+    memcpy(red, &r, sizeof(Int));
+    memcpy(green, &g, sizeof(Int));
+    memcpy(blue, &b, sizeof(Int));
+}
+
+
+template<class Int>
+CNOID_VFX_ALWAYS_INLINE void shiftBlock(unsigned char* pixels, int n, const Offsets& offsets)
+{
+    const int numLanes = sizeof(Int) / sizeof(int32_t);
+    int32_t r[BlockSize];
+    int32_t g[BlockSize];
+    int32_t b[BlockSize];
+
+    for(int k = 0; k < n; ++k) {
+        r[k] = pixels[k * 3];
+        g[k] = pixels[k * 3 + 1];
+        b[k] = pixels[k * 3 + 2];
+    }
+    for(int k = n; k < BlockSize; ++k) {
+        r[k] = g[k] = b[k] = 0;
+    }
+
+    for(int k = 0; k < BlockSize; k += numLanes) {
+        shiftLanes<Int>(&r[k], &g[k], &b[k], offsets);
+    }
+
+    for(int k = 0; k < n; ++k) {
+        pixels[k * 3] = r[k];
+        pixels[k * 3 + 1] = g[k];
+        pixels[k * 3 + 2] = b[k];
+    }
+}
+
+
+template<class Int>
+CNOID_VFX_ALWAYS_INLINE void shiftPixels(unsigned char* pixels, int numPixels, const Offsets& offsets)
+{
+    for(int k = 0; k < numPixels; k += BlockSize) {
+        shiftBlock<Int>(&pixels[k * 3], std::min(BlockSize, numPixels - k), offsets);
+    }
+}
+
+
+void shiftPixelsGeneric(unsigned char* pixels, int numPixels, const Offsets& offsets)
+{
+    shiftPixels<GenericLanes>(pixels, numPixels, offsets);
+}
+
+#ifdef CNOID_VFX_HSV_SHIFT_DISPATCH
+
+__attribute__((target("sse4.2")))
+void shiftPixelsSse42(unsigned char* pixels, int numPixels, const Offsets& offsets)
+{
+    shiftPixels<Int4>(pixels, numPixels, offsets);
+}
+
+
+__attribute__((target("avx2")))
+void shiftPixelsAvx2(unsigned char* pixels, int numPixels, const Offsets& offsets)
+{
+    shiftPixels<Int8>(pixels, numPixels, offsets);
+}
+
+#endif
+
+typedef void (*ShiftFunction)(unsigned char* pixels, int numPixels, const Offsets& offsets);
+
+ShiftFunction getShiftFunction(HsvShiftKernel kernel)
+{
+    switch(kernel) {
+    case GenericHsvShiftKernel:
+        return shiftPixelsGeneric;
+#ifdef CNOID_VFX_HSV_SHIFT_DISPATCH
+    case Sse42HsvShiftKernel:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") ? shiftPixelsSse42 : nullptr;
+    case Avx2HsvShiftKernel:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? shiftPixelsAvx2 : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+
+ShiftFunction selectShiftFunction()
+{
+    if(ShiftFunction shift = getShiftFunction(Avx2HsvShiftKernel)) {
+        return shift;
+    }
+    if(ShiftFunction shift = getShiftFunction(Sse42HsvShiftKernel)) {
+        return shift;
+    }
+    return shiftPixelsGeneric;
+}
+
+
+Offsets getOffsets(double hue, double saturation, double value)
+{
+    Offsets offsets;
+    offsets.hue = hue * 360.0;
+    offsets.saturation = saturation * 255.0;
+    offsets.value = value * 255.0;
+    return offsets;
+}
+
+}
+
+
+void cnoid::shiftHsv(unsigned char* pixels, int numPixels, double hue, double saturation, double value)
+{
+    static const ShiftFunction shift = selectShiftFunction();
+    shift(pixels, numPixels, getOffsets(hue, saturation, value));
+}
+
+
+bool cnoid::isHsvShiftKernelAvailable(HsvShiftKernel kernel)
+{
+    return getShiftFunction(kernel) != nullptr;
+}
+
+
+bool cnoid::shiftHsv(unsigned char* pixels, int numPixels, double hue, double saturation, double value,
+                     HsvShiftKernel kernel)
+{
+    ShiftFunction shift = getShiftFunction(kernel);
+    if(!shift) {
+        return false;
+    }
+    shift(pixels, numPixels, getOffsets(hue, saturation, value));
+    return true;
+}
@@ -0,0 +1,38 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_VFX_PLUGIN_HSV_SHIFT_H
+#define CNOID_VFX_PLUGIN_HSV_SHIFT_H
+
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Shifts the hue, the saturation and the value of packed 8-bit RGB pixels.
+
+   The result is the one of converting each pixel with QColor::fromRgb(),
+   adding hue * 360, saturation * 255 and value * 255 to its hue(),
+   saturation() and value(), and converting back with QColor::fromHsv().
+   The conversions are done in exact integer arithmetic instead of QColor's
+   floating-point one, so a channel may differ from QColor by one at most.
+
+   The pixels are processed in blocks of 32 by a branch-free kernel, which
+   is compiled for AVX2, SSE4.2 and the baseline instruction set. The one
+   the CPU supports is chosen at the first call.
+*/
+CNOID_EXPORT void shiftHsv(unsigned char* pixels, int numPixels, double hue, double saturation, double value);
+
+enum HsvShiftKernel { GenericHsvShiftKernel, Sse42HsvShiftKernel, Avx2HsvShiftKernel, NumHsvShiftKernels };
+
+// Whether the kernel is compiled in and the CPU supports it
+CNOID_EXPORT bool isHsvShiftKernelAvailable(HsvShiftKernel kernel);
+
+// Same as the above with the given kernel for testing it. Nothing is done and false is returned if it is not available.
+CNOID_EXPORT bool shiftHsv(unsigned char* pixels, int numPixels, double hue, double saturation, double value,
+                           HsvShiftKernel kernel);
+
+}
+
+#endif // CNOID_VFX_PLUGIN_HSV_SHIFT_H
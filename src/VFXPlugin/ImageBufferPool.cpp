@@ -0,0 +1,154 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "ImageBufferPool.h"
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class ImageBufferPool::Impl
+{
+public:
+    typedef std::shared_ptr<Impl> ImplPtr;
+
+    // Returns the image to the pool in place of deleting it
+    struct ImageRecycler
+    {
+        ImplPtr pool;
+
+        void operator()(Image* image) const
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->freeImages.push_back(image);
+        }
+    };
+
+    /*
+       Allocates the control blocks from the pool. The control block keeps a
+       copy of the allocator until the block is deallocated, so the pool lives
+       as long as one of its images is in use.
+    */
+    template<class T>
+    struct BlockAllocator
+    {
+        typedef T value_type;
+
+        ImplPtr pool;
+
+        BlockAllocator(const ImplPtr& pool) : pool(pool) { }
+        template<class U> BlockAllocator(const BlockAllocator<U>& org) : pool(org.pool) { }
+
+        T* allocate(size_t n) { return static_cast<T*>(pool->allocateBlock(n * sizeof(T))); }
+        void deallocate(T* p, size_t n) { pool->deallocateBlock(p, n * sizeof(T)); }
+
+        template<class U> bool operator==(const BlockAllocator<U>& rhs) const { return pool == rhs.pool; }
+        template<class U> bool operator!=(const BlockAllocator<U>& rhs) const { return pool != rhs.pool; }
+    };
+
+    Impl();
+    ~Impl();
+
+    void* allocateBlock(size_t size);
+    void deallocateBlock(void* block, size_t size);
+
+    std::mutex mutex;
+    vector<Image*> freeImages;
+    // the control blocks of the shared pointers, which all have the same size
+    vector<void*> freeBlocks;
+    size_t blockSize;
+    int numImages;
+};
+
+}
+
+
+ImageBufferPool::ImageBufferPool()
+    : impl(std::make_shared<Impl>())
+{
+
+}
+
+
+ImageBufferPool::Impl::Impl()
+    : blockSize(0),
+      numImages(0)
+{
+
+}
+
+
+ImageBufferPool::~ImageBufferPool()
+{
+
+}
+
+
+ImageBufferPool::Impl::~Impl()
+{
+    for(auto& image : freeImages) {
+        delete image;
+    }
+    for(auto& block : freeBlocks) {
+        ::operator delete(block);
+    }
+}
+
+
+void* ImageBufferPool::Impl::allocateBlock(size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(size == blockSize && !freeBlocks.empty()) {
+            void* block = freeBlocks.back();
+            freeBlocks.pop_back();
+            return block;
+        }
+    }
+    return ::operator new(size);
+}
+
+
+void ImageBufferPool::Impl::deallocateBlock(void* block, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(blockSize == 0) {
+        blockSize = size;
+    }
+    if(size == blockSize) {
+        freeBlocks.push_back(block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+
+std::shared_ptr<Image> ImageBufferPool::acquire()
+{
+    Image* image = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        if(!impl->freeImages.empty()) {
+            image = impl->freeImages.back();
+            impl->freeImages.pop_back();
+        } else {
+            ++impl->numImages;
+        }
+    }
+    if(!image) {
+        image = new Image;
+    }
+    return std::shared_ptr<Image>(image, Impl::ImageRecycler{ impl }, Impl::BlockAllocator<Image>(impl));
+}
+
+
+int ImageBufferPool::numImages() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->numImages;
+}
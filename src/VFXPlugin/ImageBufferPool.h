@@ -0,0 +1,45 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_VFX_PLUGIN_IMAGE_BUFFER_POOL_H
+#define CNOID_VFX_PLUGIN_IMAGE_BUFFER_POOL_H
+
+#include <cnoid/Image>
+#include <memory>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Images recycled over the frames of a camera.
+
+   acquire() returns the only reference to an image, so Camera::setImage()
+   takes it over without a copy. When the last reference to the image is
+   released, the image returns to the pool with its pixel buffer instead of
+   being deleted, and the control block of the shared pointer is recycled
+   as well. Once the pool holds as many images as the frames in flight, a
+   frame allocates nothing. The images may be released on any thread and
+   after the pool is destroyed.
+*/
+class CNOID_EXPORT ImageBufferPool
+{
+public:
+    ImageBufferPool();
+    ImageBufferPool(const ImageBufferPool& org) = delete;
+    ~ImageBufferPool();
+
+    std::shared_ptr<Image> acquire();
+
+    // The images created so far, which are either in use or free
+    int numImages() const;
+
+private:
+    class Impl;
+    // shared with the deleters of the images which are still in use
+    std::shared_ptr<Impl> impl;
+};
+
+}
+
+#endif // CNOID_VFX_PLUGIN_IMAGE_BUFFER_POOL_H
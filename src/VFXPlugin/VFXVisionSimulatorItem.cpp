@@ -12,8 +12,14 @@
 #include <cnoid/DeviceList>
 #include <cnoid/SimulatorItem>
 #include <cnoid/MultiColliderItem>
+#include <cnoid/ColliderIndex>
+#include <memory>
 #include <mutex>
-#include "VisualFilter.h"
+#include <random>
+#include <unordered_map>
+#include "ImageBufferPool.h"
+#include "VisualFilterChain.h"
+#include "VFXWorkerPool.h"
 #include "NoisyCamera.h"
 #include "VFXEventReader.h"
 #include "gettext.h"
@@ -36,12 +42,28 @@ public:
 
     DeviceList<Camera> cameras;
     ItemList<MultiColliderItem> colliders;
+    ColliderIndex colliderIndex;
     SimulatorItem* simulatorItem;
     ConnectionSet connections;
+    // guards the collider index and the events shared by the cameras
     std::mutex convertMutex;
-    VisualFilter filter;
+
+    // the cameras filter their images concurrently, each under its own lock
+    struct CameraFilter
+    {
+        std::mutex mutex;
+        VisualFilterChain chain;
+        ImageBufferPool imagePool;
+        // the colliders containing the camera, reused over the frames
+        vector<const ColliderSnapshot*> hitColliders;
+    };
+    unordered_map<Camera*, unique_ptr<CameraFilter>> cameraFilters;
+
     string vfx_event_file_path;
     vector<VFXEvent> events;
+    bool isBilinearDistortionEnabled;
+    int numFilterThreads;
+    int randomSeed;
 };
 
 }
@@ -64,7 +86,10 @@ VFXVisionSimulatorItem::VFXVisionSimulatorItem()
 
 VFXVisionSimulatorItem::Impl::Impl(VFXVisionSimulatorItem* self)
     : self(self),
-      vfx_event_file_path("")
+      vfx_event_file_path(""),
+      isBilinearDistortionEnabled(false),
+      numFilterThreads(0),
+      randomSeed(0)
 {
     self->setName("VFXVisionSimulator");
 
@@ -89,6 +114,9 @@ VFXVisionSimulatorItem::Impl::Impl(VFXVisionSimulatorItem* self, const Impl& org
     cameras.clear();
     colliders.clear();
     vfx_event_file_path = org.vfx_event_file_path;
+    isBilinearDistortionEnabled = org.isBilinearDistortionEnabled;
+    numFilterThreads = org.numFilterThreads;
+    randomSeed = org.randomSeed;
 }
 
 
@@ -113,6 +141,7 @@ bool VFXVisionSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulator
     colliders.clear();
     this->simulatorItem = simulatorItem;
     events.clear();
+    cameraFilters.clear();
 
     if(!vfx_event_file_path.empty()) {
         VFXEventReader reader;
@@ -137,6 +166,19 @@ bool VFXVisionSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulator
         }
     }
 
+    colliderIndex.setColliders(colliders);
+
+    // the cameras take the seeds in their order so that a seed reproduces the frames
+    VFXWorkerPool* workerPool = VFXWorkerPool::instance();
+    workerPool->setNumThreads(numFilterThreads);
+    const uint32_t seed = randomSeed > 0 ? randomSeed : std::random_device()();
+    for(size_t i = 0; i < cameras.size(); ++i) {
+        unique_ptr<CameraFilter>& filter = cameraFilters[cameras[i]];
+        filter.reset(new CameraFilter);
+        filter->chain.setSeed(seed + i);
+        filter->chain.setWorkerPool(workerPool);
+    }
+
     for(auto& camera : cameras) {
         connections.add(camera->sigStateChanged().connect([&, camera](){ onCameraStateChanged(camera); }));
     }
@@ -192,31 +234,37 @@ void VFXVisionSimulatorItem::Impl::onCameraStateChanged(Camera* camera)
         kernel = noisyCamera->kernel();
     }
 
-    for(auto& collider : colliders) {
-        bool is_link_collided = false;
-        if(collision(collider, link->T().translation())) {
-            hue = collider->hsv()[0];
-            saturation = collider->hsv()[1];
-            value = collider->hsv()[2];
-            red = collider->rgb()[0];
-            green = collider->rgb()[1];
-            blue = collider->rgb()[2];
-            coef_b = collider->coefB();
-            coef_d = collider->coefD();
-            std_dev = collider->stdDev();
-            salt_amount = collider->saltAmount();
-            salt_chance = collider->saltChance();
-            pepper_amount = collider->pepperAmount();
-            pepper_chance = collider->pepperChance();
-            mosaic_chance = collider->mosaicChance();
-            kernel = collider->kernel();
-
-            is_link_collided = true;
-        }
+    auto it = cameraFilters.find(camera);
+    if(it == cameraFilters.end()) {
+        return;
+    }
+    CameraFilter* filter = it->second.get();
+
+    std::unique_lock<std::mutex> lock(convertMutex);
+    vector<const ColliderSnapshot*>& hitColliders = filter->hitColliders;
+    colliderIndex.update();
+    colliderIndex.queryColliders(link->T().translation(), hitColliders);
+
+    for(auto& collider : hitColliders) {
+        hue = collider->hsv[0];
+        saturation = collider->hsv[1];
+        value = collider->hsv[2];
+        red = collider->rgb[0];
+        green = collider->rgb[1];
+        blue = collider->rgb[2];
+        coef_b = collider->coefB;
+        coef_d = collider->coefD;
+        std_dev = collider->stdDev;
+        salt_amount = collider->saltAmount;
+        salt_chance = collider->saltChance;
+        pepper_amount = collider->pepperAmount;
+        pepper_chance = collider->pepperChance;
+        mosaic_chance = collider->mosaicChance;
+        kernel = collider->kernel;
 
         for(auto& event : events) {
             for(auto& target_collider : event.targetColliders()) {
-                if(target_collider == collider->name() && is_link_collided) {
+                if(target_collider == collider->name) {
                     double begin_time = event.beginTime();
                     double end_time = std::max({ event.endTime(), event.beginTime() + event.duration() });
                     bool is_event_enabled = current_time >= begin_time ? true: false;
@@ -252,36 +300,34 @@ void VFXVisionSimulatorItem::Impl::onCameraStateChanged(Camera* camera)
         }
     }
 
+    lock.unlock();
+
+    VisualFilterChain::Parameters parameters;
+    parameters.hsv << hue, saturation, value;
+    parameters.rgb << red, green, blue;
+    parameters.coefB = coef_b;
+    parameters.coefD = coef_d;
+    parameters.stdDev = std_dev;
+    parameters.saltAmount = salt_amount;
+    parameters.saltChance = salt_chance;
+    parameters.pepperAmount = pepper_amount;
+    parameters.pepperChance = pepper_chance;
+    parameters.mosaicChance = mosaic_chance;
+    parameters.kernel = kernel;
+    parameters.bilinearDistortion = isBilinearDistortionEnabled;
+
     {
-        std::lock_guard<std::mutex> lock(convertMutex);
-        std::shared_ptr<Image> image = std::make_shared<Image>(*camera->sharedImage());
-        filter.initialize(image->width(), image->height());
-        if(hue > 0.0 || saturation > 0.0 || value > 0.0) {
-            filter.hsv(image.get(), hue, saturation, value);
-        }
-        if(red > 0.0 || green > 0.0 || blue > 0.0) {
-            filter.rgb(image.get(), red, green, blue);
-        }
-        if(std_dev > 0.0) {
-            filter.gaussian_noise(image.get(), std_dev);
-        }
-        if(salt_chance > 0.0) {
-            if(salt_amount > 0.0) {
-                filter.random_salt(image.get(), salt_amount, salt_chance);
-            }
-        }
-        if(pepper_chance > 0.0) {
-            if(pepper_amount > 0.0) {
-                filter.random_pepper(image.get(), pepper_amount, pepper_chance);
-            }
-        }
-        if(coef_b < 0.0 || coef_d > 1.0) {
-            filter.barrel_distortion(image.get(), coef_b, coef_d);
-        }
-        if(mosaic_chance > 0.0) {
-            filter.random_mosaic(image.get(), mosaic_chance, kernel);
+        std::lock_guard<std::mutex> filterLock(filter->mutex);
+        // the chain of the camera is compiled again only when the parameters change
+        VisualFilterChain& chain = filter->chain;
+        chain.setParameters(parameters);
+        if(!chain.isEmpty()) {
+            // the frame is filtered into a recycled image, which the camera takes over without a copy
+            std::shared_ptr<const Image> source = camera->sharedImage();
+            std::shared_ptr<Image> image = filter->imagePool.acquire();
+            chain.apply(*source, image.get());
+            camera->setImage(image);
         }
-        camera->setImage(image);
     }
 }
 
@@ -300,6 +346,10 @@ void VFXVisionSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
                     impl->vfx_event_file_path = value;
                     return true;
                 });
+    putProperty(_("Bilinear distortion"), impl->isBilinearDistortionEnabled,
+                changeProperty(impl->isBilinearDistortionEnabled));
+    putProperty.min(0)(_("Number of filter threads"), impl->numFilterThreads, changeProperty(impl->numFilterThreads));
+    putProperty.min(0)(_("Random seed"), impl->randomSeed, changeProperty(impl->randomSeed));
 }
 
 
@@ -309,6 +359,9 @@ bool VFXVisionSimulatorItem::store(Archive& archive)
         return false;
     }
     archive.writeRelocatablePath("vfx_event_file_path", impl->vfx_event_file_path);
+    archive.write("bilinear_distortion", impl->isBilinearDistortionEnabled);
+    archive.write("num_filter_threads", impl->numFilterThreads);
+    archive.write("random_seed", impl->randomSeed);
     return true;
 }
 
@@ -325,5 +378,8 @@ bool VFXVisionSimulatorItem::restore(const Archive& archive)
             impl->vfx_event_file_path = symbol;
         }
     }
+    archive.read("bilinear_distortion", impl->isBilinearDistortionEnabled);
+    archive.read("num_filter_threads", impl->numFilterThreads);
+    archive.read("random_seed", impl->randomSeed);
     return true;
 }
\ No newline at end of file
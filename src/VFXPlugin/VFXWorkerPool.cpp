@@ -0,0 +1,189 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "VFXWorkerPool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Loop
+{
+    const std::function<void(int)>* func;
+    int numIndices;
+    int nextIndex;
+    int numFinishedIndices;
+};
+
+}
+
+namespace cnoid {
+
+class VFXWorkerPool::Impl
+{
+public:
+    Impl();
+    ~Impl();
+
+    void start(int numThreads);
+    void stop();
+    void work();
+    bool runNextIndex(Loop* loop, std::unique_lock<std::mutex>& lock);
+
+    vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable finishCondition;
+    // the loops which still have indices to be taken, whose capacity is kept over the loops
+    vector<Loop*> pendingLoops;
+    bool isExiting;
+};
+
+}
+
+
+VFXWorkerPool* VFXWorkerPool::instance()
+{
+    static VFXWorkerPool pool;
+    return &pool;
+}
+
+
+VFXWorkerPool::VFXWorkerPool()
+{
+    impl = new Impl;
+}
+
+
+VFXWorkerPool::Impl::Impl()
+    : isExiting(false)
+{
+
+}
+
+
+VFXWorkerPool::~VFXWorkerPool()
+{
+    delete impl;
+}
+
+
+VFXWorkerPool::Impl::~Impl()
+{
+    stop();
+}
+
+
+void VFXWorkerPool::setNumThreads(int numThreads)
+{
+    if(numThreads <= 0) {
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    if(numThreads != this->numThreads()) {
+        impl->stop();
+        impl->start(numThreads);
+    }
+}
+
+
+int VFXWorkerPool::numThreads() const
+{
+    // a calling thread is counted as one of the workers
+    return impl->threads.size() + 1;
+}
+
+
+void VFXWorkerPool::Impl::start(int numThreads)
+{
+    isExiting = false;
+    for(int i = 1; i < numThreads; ++i) {
+        threads.emplace_back([this](){ work(); });
+    }
+}
+
+
+void VFXWorkerPool::Impl::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isExiting = true;
+    }
+    startCondition.notify_all();
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+
+void VFXWorkerPool::Impl::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        startCondition.wait(lock, [&](){ return isExiting || !pendingLoops.empty(); });
+        if(isExiting) {
+            break;
+        }
+        runNextIndex(pendingLoops.front(), lock);
+    }
+}
+
+
+/*
+   Takes an index of the loop and runs it without the lock.
+   Returns false when the loop has no index left.
+*/
+bool VFXWorkerPool::Impl::runNextIndex(Loop* loop, std::unique_lock<std::mutex>& lock)
+{
+    if(loop->nextIndex >= loop->numIndices) {
+        return false;
+    }
+    const int index = loop->nextIndex++;
+    if(loop->nextIndex == loop->numIndices) {
+        pendingLoops.erase(std::find(pendingLoops.begin(), pendingLoops.end(), loop));
+    }
+
+    lock.unlock();
+    (*loop->func)(index);
+    lock.lock();
+
+    if(++loop->numFinishedIndices == loop->numIndices) {
+        finishCondition.notify_all();
+    }
+    return true;
+}
+
+
+void VFXWorkerPool::parallelFor(int n, const std::function<void(int index)>& func)
+{
+    if(n <= 0) {
+        return;
+    }
+    if(impl->threads.empty() || n == 1) {
+        for(int i = 0; i < n; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    Loop loop;
+    loop.func = &func;
+    loop.numIndices = n;
+    loop.nextIndex = 0;
+    loop.numFinishedIndices = 0;
+
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    impl->pendingLoops.push_back(&loop);
+    impl->startCondition.notify_all();
+
+    while(impl->runNextIndex(&loop, lock)) { }
+
+    impl->finishCondition.wait(lock, [&](){ return loop.numFinishedIndices == loop.numIndices; });
+}
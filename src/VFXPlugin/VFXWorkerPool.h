@@ -0,0 +1,43 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_VFX_PLUGIN_VFX_WORKER_POOL_H
+#define CNOID_VFX_PLUGIN_VFX_WORKER_POOL_H
+
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   A bounded set of worker threads running index-parallel loops for the
+   filters of all the cameras. parallelFor() may be called from several
+   threads at once. The calling thread takes part in its own loop, the
+   idle workers help the loops in the order they were started, and the
+   call returns after all of its indices have been processed.
+*/
+class CNOID_EXPORT VFXWorkerPool
+{
+public:
+    // The pool shared across the plugin
+    static VFXWorkerPool* instance();
+
+    VFXWorkerPool();
+    VFXWorkerPool(const VFXWorkerPool& org) = delete;
+    ~VFXWorkerPool();
+
+    // 0 selects the number of hardware threads. This must not be called during a loop.
+    void setNumThreads(int numThreads);
+    int numThreads() const;
+
+    void parallelFor(int n, const std::function<void(int index)>& func);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif // CNOID_VFX_PLUGIN_VFX_WORKER_POOL_H
@@ -3,6 +3,7 @@
 */
 
 #include "VisualFilter.h"
+#include "HsvShift.h"
 
 using namespace cnoid;
 
@@ -210,29 +211,7 @@ void VisualFilter::rgb(Image* image, const double& red, const double& green, con
 void VisualFilter::hsv(Image* image, const double& hue, const double& saturation, const double& value)
 {
     image->setSize(width_, height_, 3);
-    unsigned char* pixels = image->pixels();
-
-    for(int j = 0; j < height_; ++j) {
-        for(int i = 0; i < width_; ++i) {
-            unsigned char* pix = &pixels[(i + j * width_) * 3];
-            QColor rgb = QColor::fromRgb(pix[0], pix[1], pix[2]);
-            int h = rgb.hue() + hue * 360.0;
-            int s = rgb.saturation() + saturation * 255.0;
-            int v = rgb.value() + value * 255.0;
-
-            h = h > 359 ? h - 360 : h;
-            h = h < 0 ? 0 : h;
-            s = s > 255 ? 255 : s;
-            s = s < 0 ? 0 : s;
-            v = v > 255 ? 255 : v;
-            v = v < 0 ? 0 : v;
-
-            QColor hsv = QColor::fromHsv(h, s, v);
-            pix[0] = hsv.red();
-            pix[1] = hsv.green();
-            pix[2] = hsv.blue();
-        }
-    }
+    shiftHsv(image->pixels(), width_ * height_, hue, saturation, value);
 }
 
 
@@ -258,8 +237,9 @@ void VisualFilter::barrel_distortion(Image* image, const double& coef_b, const d
     image->setSize(width_, height_, 3);
     unsigned char* pixels = image->pixels();
 
-    std::shared_ptr<Image> srcImage = std::make_shared<Image>(*image);
-    unsigned char* src = srcImage->pixels();
+    // the copy of the source keeps its capacity over the calls
+    buffer_.assign(pixels, pixels + width_ * height_ * 3);
+    unsigned char* src = buffer_.data();
     this->black(image);
 
     double coefa = 0.0;
@@ -298,8 +278,9 @@ void VisualFilter::mosaic(Image* image, int kernel)
     image->setSize(width_, height_, 3);
     unsigned char* pixels = image->pixels();
 
-    std::shared_ptr<Image> srcImage = std::make_shared<Image>(*image);
-    unsigned char* src = srcImage->pixels();
+    // the copy of the source keeps its capacity over the calls
+    buffer_.assign(pixels, pixels + width_ * height_ * 3);
+    unsigned char* src = buffer_.data();
 
     int r, g, b;
     int margin_x, margin_y;
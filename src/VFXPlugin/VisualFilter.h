@@ -9,6 +9,7 @@
 #include <QImage>
 #include <random>
 #include <memory>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -44,6 +45,7 @@ private:
     std::random_device seed_gen_;
     std::default_random_engine engine_;
     std::normal_distribution<> dist_;
+    std::vector<unsigned char> buffer_;
 };
 
 void toCnoidImage(Image* image, QImage q_image);
@@ -0,0 +1,444 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "VisualFilterChain.h"
+#include "HsvShift.h"
+#include "VFXWorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+uint64_t splitMix64(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+}
+
+
+VisualFilterChain::Parameters::Parameters()
+{
+    hsv.setZero();
+    rgb.setZero();
+    coefB = 0.0;
+    coefD = 1.0;
+    stdDev = 0.0;
+    saltAmount = 0.0;
+    saltChance = 0.0;
+    pepperAmount = 0.0;
+    pepperChance = 0.0;
+    mosaicChance = 0.0;
+    kernel = 16;
+    bilinearDistortion = false;
+}
+
+
+bool VisualFilterChain::Parameters::operator==(const Parameters& rhs) const
+{
+    return hsv == rhs.hsv
+        && rgb == rhs.rgb
+        && coefB == rhs.coefB
+        && coefD == rhs.coefD
+        && stdDev == rhs.stdDev
+        && saltAmount == rhs.saltAmount
+        && saltChance == rhs.saltChance
+        && pepperAmount == rhs.pepperAmount
+        && pepperChance == rhs.pepperChance
+        && mosaicChance == rhs.mosaicChance
+        && kernel == rhs.kernel
+        && bilinearDistortion == rhs.bilinearDistortion;
+}
+
+
+VisualFilterChain::VisualFilterChain()
+    : remapWidth(0),
+      remapHeight(0),
+      remapCoefB(0.0),
+      remapCoefD(0.0),
+      isRemapBilinear(false),
+      workerPool(nullptr),
+      seed(std::random_device()()),
+      frameCount(0)
+{
+    compile();
+}
+
+
+void VisualFilterChain::setSeed(uint32_t seed)
+{
+    this->seed = seed;
+    frameCount = 0;
+}
+
+
+void VisualFilterChain::setParameters(const Parameters& parameters)
+{
+    if(parameters != parameters_) {
+        parameters_ = parameters;
+        compile();
+    }
+}
+
+
+void VisualFilterChain::compile()
+{
+    const Parameters& p = parameters_;
+    hasHsv = p.hsv[0] > 0.0 || p.hsv[1] > 0.0 || p.hsv[2] > 0.0;
+    hasRgb = p.rgb[0] > 0.0 || p.rgb[1] > 0.0 || p.rgb[2] > 0.0;
+    hasNoise = p.stdDev > 0.0;
+    hasSalt = p.saltChance > 0.0 && p.saltAmount > 0.0;
+    hasPepper = p.pepperChance > 0.0 && p.pepperAmount > 0.0;
+    hasDistortion = p.coefB < 0.0 || p.coefD > 1.0;
+    hasMosaic = p.mosaicChance > 0.0 && p.kernel > 0;
+}
+
+
+bool VisualFilterChain::isEmpty() const
+{
+    return !(hasHsv || hasRgb || hasNoise || hasSalt || hasPepper || hasDistortion || hasMosaic);
+}
+
+
+VisualFilterChain::Random::Random(uint32_t seed, uint64_t frame, int stream)
+    : normalDistribution(0.0, 1.0)
+{
+    uint64_t x = ((uint64_t)seed << 32) ^ frame ^ ((uint64_t)stream * 0xd1b54a32d192ed03ULL);
+    for(int i = 0; i < 4; ++i) {
+        state[i] = (uint32_t)splitMix64(x);
+    }
+    state[0] |= 1; // xorshift never leaves the all-zero state
+    engine.seed((uint32_t)splitMix64(x));
+}
+
+
+double VisualFilterChain::Random::uniform()
+{
+    uint32_t* s = state;
+    uint32_t t = s[0] ^ (s[0] << 11);
+    s[0] = s[1];
+    s[1] = s[2];
+    s[2] = s[3];
+    s[3] = (s[3] ^ (s[3] >> 19)) ^ (t ^ (t >> 8));
+    return (double)(s[3] % 100) / 100.0;
+}
+
+
+double VisualFilterChain::Random::normal()
+{
+    return normalDistribution(engine);
+}
+
+
+// func is called with the ranges of the rows
+template<class Function>
+void VisualFilterChain::parallelForRows(int numRows, const Function& func)
+{
+    const int numThreads = workerPool ? workerPool->numThreads() : 1;
+    if(numThreads <= 1 || numRows <= 1) {
+        func(0, numRows);
+        return;
+    }
+
+    // a few tasks per thread even out the rows which take longer
+    struct Tasks
+    {
+        const Function* func;
+        int numRows;
+        int rowsPerTask;
+    } tasks;
+    tasks.func = &func;
+    tasks.numRows = numRows;
+    tasks.rowsPerTask = std::max(1, numRows / (numThreads * 4));
+    const int numTasks = (numRows + tasks.rowsPerTask - 1) / tasks.rowsPerTask;
+
+    // the loop function only captures a pointer so that it is stored without an allocation
+    const Tasks* pTasks = &tasks;
+    workerPool->parallelFor(
+        numTasks,
+        [pTasks](int index){
+            const int begin = index * pTasks->rowsPerTask;
+            (*pTasks->func)(begin, std::min(pTasks->numRows, begin + pTasks->rowsPerTask));
+        });
+}
+
+
+void VisualFilterChain::apply(Image* image)
+{
+    apply(*image, image);
+}
+
+
+void VisualFilterChain::apply(const Image& source, Image* image)
+{
+    if(image != &source) {
+        if(source.numComponents() != 3 || source.empty()) {
+            // the frame is passed through into the recycled buffer without reallocating it
+            image->setSize(source.width(), source.height(), source.numComponents());
+            if(!source.empty()) {
+                memcpy(image->pixels(), source.pixels(),
+                       (size_t)source.width() * source.height() * source.numComponents());
+            }
+            return;
+        }
+        image->setSize(source.width(), source.height(), 3);
+    } else if(image->numComponents() != 3 || image->empty()) {
+        return;
+    }
+
+    // the chances are drawn once per frame as VisualFilter::random_salt() and random_pepper() do,
+    // from the stream 0 of the frame while the rows take the streams from 1
+    Random random(seed, frameCount, 0);
+    const bool doSalt = hasSalt && random.uniform() < parameters_.saltChance;
+    const bool doPepper = hasPepper && random.uniform() < parameters_.pepperChance;
+    const bool doMosaic = hasMosaic && random.uniform() < parameters_.mosaicChance;
+
+    // each stage reads the output of the previous one, which is the source at first
+    const unsigned char* src = source.pixels();
+    if(hasHsv || hasRgb || hasNoise || doSalt || doPepper) {
+        applyPixelStages(src, image, doSalt, doPepper);
+        src = image->pixels();
+    }
+    if(hasDistortion) {
+        applyBarrelDistortion(src, image);
+        src = image->pixels();
+    }
+    if(src != image->pixels()) {
+        memcpy(image->pixels(), src, (size_t)image->width() * image->height() * 3);
+    }
+    if(doMosaic) {
+        applyMosaic(image);
+    }
+    ++frameCount;
+}
+
+
+void VisualFilterChain::applyPixelStages(const unsigned char* src, Image* image, bool doSalt, bool doPepper)
+{
+    const Parameters& p = parameters_;
+    const int width = image->width();
+    const int height = image->height();
+    unsigned char* pixels = image->pixels();
+
+    const bool isRandom = hasNoise || doSalt || doPepper;
+
+    // the vectorized hsv kernel runs on a row before the other stages visit it,
+    // so that the row is still in the cache
+    parallelForRows(
+        height,
+        [&](int begin, int end){
+            for(int j = begin; j < end; ++j) {
+                unsigned char* row = &pixels[j * width * 3];
+                if(src != pixels) {
+                    memcpy(row, &src[j * width * 3], width * 3);
+                }
+                if(hasHsv) {
+                    shiftHsv(row, width, p.hsv[0], p.hsv[1], p.hsv[2]);
+                }
+                if(!(hasRgb || isRandom)) {
+                    continue;
+                }
+                Random random(seed, frameCount, j + 1);
+                for(int i = 0; i < width; ++i) {
+                    unsigned char* pix = &row[i * 3];
+                    if(hasRgb) {
+                        pix[0] += 255 * p.rgb[0];
+                        pix[1] += 255 * p.rgb[1];
+                        pix[2] += 255 * p.rgb[2];
+                    }
+                    if(hasNoise) {
+                        double c = 255 * p.stdDev * random.normal();
+                        pix[0] += c;
+                        pix[1] += c;
+                        pix[2] += c;
+                    }
+                    if(doSalt && random.uniform() < p.saltAmount) {
+                        pix[0] = pix[1] = pix[2] = 255;
+                    }
+                    if(doPepper && random.uniform() < p.pepperAmount) {
+                        pix[0] = pix[1] = pix[2] = 0;
+                    }
+                }
+            }
+        });
+}
+
+
+void VisualFilterChain::applyBarrelDistortion(const unsigned char* src, Image* image)
+{
+    const Parameters& p = parameters_;
+    const int width = image->width();
+    const int height = image->height();
+    unsigned char* pixels = image->pixels();
+
+    if(width != remapWidth || height != remapHeight || p.coefB != remapCoefB || p.coefD != remapCoefD
+       || p.bilinearDistortion != isRemapBilinear) {
+        updateRemapTable(width, height);
+    }
+
+    // the gather reads the pixels before the distortion, which are copied to the buffer
+    // kept over the frames only when the image is its own source
+    if(src == pixels) {
+        const size_t size = (size_t)width * height * 3;
+        sourcePixels.resize(size);
+        memcpy(sourcePixels.data(), pixels, size);
+        src = sourcePixels.data();
+    }
+
+    parallelForRows(
+        height,
+        [&](int begin, int end){
+            const int kBegin = begin * width;
+            const int kEnd = end * width;
+            if(!isRemapBilinear) {
+                for(int k = kBegin; k < kEnd; ++k) {
+                    unsigned char* pix = &pixels[k * 3];
+                    const int32_t offset = remapOffsets[k];
+                    if(offset >= 0) {
+                        pix[0] = src[offset];
+                        pix[1] = src[offset + 1];
+                        pix[2] = src[offset + 2];
+                    } else {
+                        pix[0] = pix[1] = pix[2] = 0;
+                    }
+                }
+            } else {
+                for(int k = kBegin; k < kEnd; ++k) {
+                    unsigned char* pix = &pixels[k * 3];
+                    const RemapSample& sample = remapSamples[k];
+                    for(int c = 0; c < 3; ++c) {
+                        uint32_t sum = 0;
+                        for(int n = 0; n < 4; ++n) {
+                            sum += sample.weights[n] * src[sample.offsets[n] + c];
+                        }
+                        pix[c] = (sum + 8192) >> 14;
+                    }
+                }
+            }
+        });
+}
+
+
+void VisualFilterChain::updateRemapTable(int width, int height)
+{
+    const Parameters& p = parameters_;
+    remapWidth = width;
+    remapHeight = height;
+    remapCoefB = p.coefB;
+    remapCoefD = p.coefD;
+    isRemapBilinear = p.bilinearDistortion;
+
+    const size_t numPixels = (size_t)width * height;
+    if(isRemapBilinear) {
+        remapSamples.resize(numPixels);
+        remapOffsets.clear();
+    } else {
+        remapOffsets.resize(numPixels);
+        remapSamples.clear();
+    }
+
+    const double coefa = 0.0;
+    const double coefb = p.coefB;
+    const double coefc = 0.0;
+    const double coefd = p.coefD - coefa - coefb - coefc;
+    const int d = std::min(width, height) / 2;
+    const double cntx = (width - 1) / 2.0;
+    const double cnty = (height - 1) / 2.0;
+
+    for(int j = 0; j < height; ++j) {
+        const double dely = (j - cnty) / d;
+        for(int i = 0; i < width; ++i) {
+            const int index = i + j * width;
+            const double delx = (i - cntx) / d;
+            const double dstr = sqrt(delx * delx + dely * dely);
+            const double srcr = (coefa * dstr * dstr * dstr + coefb * dstr * dstr + coefc * dstr + coefd) * dstr;
+            const double fctr = dstr > 0.0 ? fabs(dstr / srcr) : 1.0;
+            const double srcx = cntx + (delx * fctr * d);
+            const double srcy = cnty + (dely * fctr * d);
+
+            // the nearest pixel is the one VisualFilter::barrel_distortion() takes by the truncation
+            const bool isInside = srcx > -1.0 && srcx < width && srcy > -1.0 && srcy < height;
+
+            if(!isRemapBilinear) {
+                remapOffsets[index] = isInside ? ((int)srcy * width + (int)srcx) * 3 : -1;
+                continue;
+            }
+
+            // the weights of the four neighbors are in 1/16384, and those outside the image are black
+            RemapSample& sample = remapSamples[index];
+            for(int n = 0; n < 4; ++n) {
+                sample.offsets[n] = 0;
+                sample.weights[n] = 0;
+            }
+            if(isInside) {
+                const double x0 = floor(srcx);
+                const double y0 = floor(srcy);
+                const int fx = (int)((srcx - x0) * 128.0 + 0.5);
+                const int fy = (int)((srcy - y0) * 128.0 + 0.5);
+                const int xs[2] = { (int)x0, (int)x0 + 1 };
+                const int ys[2] = { (int)y0, (int)y0 + 1 };
+                const int wxs[2] = { 128 - fx, fx };
+                const int wys[2] = { 128 - fy, fy };
+                for(int n = 0; n < 4; ++n) {
+                    const int x = xs[n & 1];
+                    const int y = ys[n >> 1];
+                    if(x >= 0 && y >= 0 && x < width && y < height) {
+                        sample.offsets[n] = (y * width + x) * 3;
+                        sample.weights[n] = wxs[n & 1] * wys[n >> 1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void VisualFilterChain::applyMosaic(Image* image)
+{
+    const int width = image->width();
+    const int height = image->height();
+    const int kernel = parameters_.kernel;
+    unsigned char* pixels = image->pixels();
+
+    // each block only reads and writes its own pixels, so no copy of the image is needed
+    // and the rows of blocks are processed in parallel
+    const int numBlockRows = (height + kernel - 1) / kernel;
+    parallelForRows(
+        numBlockRows,
+        [&](int begin, int end){
+            for(int j = begin * kernel; j < std::min(height, end * kernel); j += kernel) {
+                const int ny = std::min(kernel, height - j);
+                for(int i = 0; i < width; i += kernel) {
+                    const int nx = std::min(kernel, width - i);
+                    int r = 0;
+                    int g = 0;
+                    int b = 0;
+                    for(int y = 0; y < ny; ++y) {
+                        const unsigned char* pix = &pixels[(i + (j + y) * width) * 3];
+                        for(int x = 0; x < nx; ++x) {
+                            r += pix[x * 3];
+                            g += pix[x * 3 + 1];
+                            b += pix[x * 3 + 2];
+                        }
+                    }
+                    const int n = nx * ny;
+                    for(int y = 0; y < ny; ++y) {
+                        unsigned char* pix = &pixels[(i + (j + y) * width) * 3];
+                        for(int x = 0; x < nx; ++x) {
+                            pix[x * 3] = r / n;
+                            pix[x * 3 + 1] = g / n;
+                            pix[x * 3 + 2] = b / n;
+                        }
+                    }
+                }
+            }
+        });
+}
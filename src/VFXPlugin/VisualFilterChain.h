@@ -0,0 +1,134 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef CNOID_VFX_PLUGIN_VISUAL_FILTER_CHAIN_H
+#define CNOID_VFX_PLUGIN_VISUAL_FILTER_CHAIN_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/Image>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class VFXWorkerPool;
+
+/**
+   The effects of VisualFilter compiled for the parameters of a camera.
+   hsv, rgb, gaussian noise, salt and pepper are applied to each pixel in
+   one traversal of the image, and only the geometric stages, the barrel
+   distortion and the mosaic, take their own passes. The stages are
+   compiled again only when the parameters change, and the distortion is
+   a gather through a table cached for the image size and the coefficients.
+
+   The rows are split among the threads of a worker pool when one is given.
+   Every row draws its noise from its own random stream derived from the
+   seed, the frame number and the row, so the result of a seed does not
+   depend on the number of threads.
+*/
+class CNOID_EXPORT VisualFilterChain
+{
+public:
+    struct Parameters
+    {
+        Parameters();
+        bool operator==(const Parameters& rhs) const;
+        bool operator!=(const Parameters& rhs) const { return !(*this == rhs); }
+
+        Vector3 hsv;
+        Vector3 rgb;
+        double coefB;
+        double coefD;
+        double stdDev;
+        double saltAmount;
+        double saltChance;
+        double pepperAmount;
+        double pepperChance;
+        double mosaicChance;
+        int kernel;
+        // samples the distorted image bilinearly instead of taking the nearest pixel
+        bool bilinearDistortion;
+    };
+
+    VisualFilterChain();
+
+    void setParameters(const Parameters& parameters);
+    const Parameters& parameters() const { return parameters_; }
+
+    // true when no stage changes the image
+    bool isEmpty() const;
+
+    // Starts the random streams over from the seed
+    void setSeed(uint32_t seed);
+
+    // The rows are processed on the calling thread when the pool is null
+    void setWorkerPool(VFXWorkerPool* pool) { workerPool = pool; }
+
+    // Applies the stages to the 3-channel image in place
+    void apply(Image* image);
+
+    /**
+       Writes the filtered source to the image, whose pixel buffer is reused
+       when the size does not change. The first stage reads the source, so
+       the source is not copied beforehand.
+    */
+    void apply(const Image& source, Image* image);
+
+private:
+    class Random
+    {
+    public:
+        Random(uint32_t seed, uint64_t frame, int stream);
+        // in hundredths as VisualFilter draws them
+        double uniform();
+        double normal();
+
+    private:
+        uint32_t state[4];
+        std::default_random_engine engine;
+        std::normal_distribution<> normalDistribution;
+    };
+
+    void compile();
+    template<class Function> void parallelForRows(int numRows, const Function& func);
+    void applyPixelStages(const unsigned char* src, Image* image, bool doSalt, bool doPepper);
+    void applyBarrelDistortion(const unsigned char* src, Image* image);
+    void updateRemapTable(int width, int height);
+    void applyMosaic(Image* image);
+
+    Parameters parameters_;
+    bool hasHsv;
+    bool hasRgb;
+    bool hasNoise;
+    bool hasSalt;
+    bool hasPepper;
+    bool hasDistortion;
+    bool hasMosaic;
+
+    std::vector<unsigned char> sourcePixels;
+
+    // the source of each pixel under the barrel distortion, built for the size and the coefficients below
+    struct RemapSample
+    {
+        int32_t offsets[4];
+        uint16_t weights[4];
+    };
+    std::vector<int32_t> remapOffsets;
+    std::vector<RemapSample> remapSamples;
+    int remapWidth;
+    int remapHeight;
+    double remapCoefB;
+    double remapCoefD;
+    bool isRemapBilinear;
+
+    VFXWorkerPool* workerPool;
+    uint32_t seed;
+    uint64_t frameCount;
+};
+
+}
+
+#endif // CNOID_VFX_PLUGIN_VISUAL_FILTER_CHAIN_H
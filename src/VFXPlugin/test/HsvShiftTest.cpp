@@ -0,0 +1,184 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include <cnoid/HsvShift>
+#include <QColor>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Options
+{
+    int stride = 3;
+};
+
+struct Shift
+{
+    double hue;
+    double saturation;
+    double value;
+};
+
+const Shift shifts[] = {
+    { 0.0, 0.0, 0.0 },
+    { 0.5, 0.0, 0.0 },
+    { -0.25, 0.0, 0.0 },
+    { 0.999, 0.0, 0.0 },
+    { 0.0, 0.3, 0.0 },
+    { 0.0, -0.6, 0.0 },
+    { 0.0, 0.0, 0.2 },
+    { 0.0, 0.0, -0.45 },
+    { 0.1, 0.2, 0.1 },
+    { -0.7, -0.1, 0.35 },
+    { 1.0, 1.0, 1.0 },
+    { -1.0, -1.0, -1.0 }
+};
+
+const char* kernelNames[] = { "generic", "sse4.2", "avx2" };
+
+void printUsage()
+{
+    printf("Usage: vfx-hsv-shift-test [--stride N]\n");
+}
+
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for(int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        const char* value = (i + 1 < argc) ? argv[++i] : nullptr;
+        if(!value) {
+            return false;
+        }
+        if(arg == "--stride") {
+            options.stride = atoi(value);
+        } else {
+            return false;
+        }
+    }
+    return options.stride > 0;
+}
+
+
+// The conversion VisualFilter did for each pixel before the kernel replaced it
+void shiftHsvWithQColor(unsigned char* pixels, int numPixels, double hue, double saturation, double value)
+{
+    for(int k = 0; k < numPixels; ++k) {
+        unsigned char* pix = &pixels[k * 3];
+        QColor rgb = QColor::fromRgb(pix[0], pix[1], pix[2]);
+        int h = rgb.hue() + hue * 360.0;
+        int s = rgb.saturation() + saturation * 255.0;
+        int v = rgb.value() + value * 255.0;
+
+        h = h > 359 ? h - 360 : h;
+        h = h < 0 ? 0 : h;
+        s = s > 255 ? 255 : s;
+        s = s < 0 ? 0 : s;
+        v = v > 255 ? 255 : v;
+        v = v < 0 ? 0 : v;
+
+        QColor hsv = QColor::fromHsv(h, s, v);
+        pix[0] = hsv.red();
+        pix[1] = hsv.green();
+        pix[2] = hsv.blue();
+    }
+}
+
+
+// The levels from 0 to 255 at the stride, always including 255
+vector<int> getLevels(int stride)
+{
+    vector<int> levels;
+    for(int x = 0; x < 255; x += stride) {
+        levels.push_back(x);
+    }
+    levels.push_back(255);
+    return levels;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if(!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    const vector<int> levels = getLevels(options.stride);
+    vector<unsigned char> source;
+    for(auto& r : levels) {
+        for(auto& g : levels) {
+            for(auto& b : levels) {
+                source.push_back(r);
+                source.push_back(g);
+                source.push_back(b);
+            }
+        }
+    }
+    const int numPixels = source.size() / 3;
+    printf("%d pixels, %d shifts\n", numPixels, (int)(sizeof(shifts) / sizeof(shifts[0])));
+
+    int numFailures = 0;
+    vector<unsigned char> expected;
+    vector<unsigned char> pixels;
+
+    for(auto& shift : shifts) {
+        expected = source;
+        shiftHsvWithQColor(expected.data(), numPixels, shift.hue, shift.saturation, shift.value);
+
+        for(int kernel = 0; kernel < NumHsvShiftKernels; ++kernel) {
+            pixels = source;
+            if(!shiftHsv(pixels.data(), numPixels, shift.hue, shift.saturation, shift.value,
+                         static_cast<HsvShiftKernel>(kernel))) {
+                continue;
+            }
+            int numDifferences = 0;
+            int numErrors = 0;
+            for(int k = 0; k < numPixels * 3; ++k) {
+                const int d = abs(pixels[k] - expected[k]);
+                if(d > 0) {
+                    ++numDifferences;
+                }
+                if(d > 1) {
+                    if(numErrors < 5) {
+                        const int i = k / 3 * 3;
+                        printf("  (%d, %d, %d): (%d, %d, %d) instead of (%d, %d, %d)\n",
+                               source[i], source[i + 1], source[i + 2],
+                               pixels[i], pixels[i + 1], pixels[i + 2],
+                               expected[i], expected[i + 1], expected[i + 2]);
+                    }
+                    ++numErrors;
+                }
+            }
+            printf("%-8s shift (%g, %g, %g): %d channels off by one, %d beyond\n",
+                   kernelNames[kernel], shift.hue, shift.saturation, shift.value, numDifferences - numErrors, numErrors);
+            if(numErrors > 0) {
+                ++numFailures;
+            }
+        }
+    }
+
+    for(int kernel = 0; kernel < NumHsvShiftKernels; ++kernel) {
+        if(!isHsvShiftKernelAvailable(static_cast<HsvShiftKernel>(kernel))) {
+            printf("%s is not available on this CPU and was skipped\n", kernelNames[kernel]);
+        }
+    }
+
+    if(numFailures > 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}